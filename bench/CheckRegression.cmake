@@ -0,0 +1,105 @@
+# Compares two Google Benchmark JSON result files, run in script mode:
+#
+#   cmake -DRESULTS=new.json -DBASELINE=old.json [-DTOLERANCE=10]
+#         -P CheckRegression.cmake
+#
+# Fails when a benchmark present in both is slower than in the baseline by
+# more than TOLERANCE percent, on real time and on each latency percentile
+# counter. Benchmarks missing from either side are skipped.
+
+cmake_minimum_required(VERSION 3.20)
+
+if(NOT DEFINED TOLERANCE)
+  set(TOLERANCE 10)
+endif()
+if(NOT EXISTS "${BASELINE}")
+  message(STATUS "No baseline at ${BASELINE}; nothing to compare. Copy "
+                 "${RESULTS} there to record one.")
+  return()
+endif()
+
+file(READ "${RESULTS}" results)
+file(READ "${BASELINE}" baseline)
+
+# Maps benchmark name -> index for the baseline.
+string(JSON baselineCount LENGTH "${baseline}" benchmarks)
+math(EXPR baselineLast "${baselineCount} - 1")
+foreach(i RANGE ${baselineLast})
+  string(JSON name GET "${baseline}" benchmarks ${i} name)
+  string(MAKE_C_IDENTIFIER "${name}" key)
+  set(baseline_${key} ${i})
+endforeach()
+
+# CMake math is integer only: turns a JSON number such as
+# 2.6226118272750849e+01 into thousandths, 26226.
+function(to_milli value out)
+  if(NOT value MATCHES "^-?([0-9]+)(\\.([0-9]*))?([eE]([+-]?[0-9]+))?$")
+    set(${out} 0 PARENT_SCOPE)
+    return()
+  endif()
+  set(digits "${CMAKE_MATCH_1}${CMAKE_MATCH_3}")
+  string(LENGTH "${CMAKE_MATCH_3}" fractionLength)
+  set(exponent 0)
+  if(CMAKE_MATCH_5)
+    set(exponent ${CMAKE_MATCH_5})
+  endif()
+  math(EXPR shift "${exponent} - ${fractionLength} + 3")
+
+  string(LENGTH "${digits}" length)
+  if(shift LESS 0)
+    math(EXPR keep "${length} + ${shift}")
+    if(keep LESS_EQUAL 0)
+      set(digits 0)
+    else()
+      string(SUBSTRING "${digits}" 0 ${keep} digits)
+    endif()
+  else()
+    string(REPEAT "0" ${shift} zeros)
+    string(APPEND digits "${zeros}")
+  endif()
+  string(REGEX REPLACE "^0+([0-9])" "\\1" digits "${digits}")
+  set(${out} ${digits} PARENT_SCOPE)
+endfunction()
+
+set(metrics real_time p50_ns p99_ns p99.9_ns)
+set(failures 0)
+string(JSON resultCount LENGTH "${results}" benchmarks)
+math(EXPR resultLast "${resultCount} - 1")
+foreach(i RANGE ${resultLast})
+  string(JSON name GET "${results}" benchmarks ${i} name)
+  string(MAKE_C_IDENTIFIER "${name}" key)
+  if(NOT DEFINED baseline_${key})
+    continue()
+  endif()
+
+  foreach(metric IN LISTS metrics)
+    string(JSON now ERROR_VARIABLE missing GET "${results}" benchmarks
+           ${i} ${metric})
+    string(JSON before ERROR_VARIABLE missingBefore GET "${baseline}"
+           benchmarks ${baseline_${key}} ${metric})
+    if(missing OR missingBefore)
+      continue()
+    endif()
+
+    # Compared in parts per ten thousand.
+    to_milli("${now}" nowInt)
+    to_milli("${before}" beforeInt)
+    if(beforeInt EQUAL 0)
+      continue()
+    endif()
+    math(EXPR change "(${nowInt} - ${beforeInt}) * 10000 / ${beforeInt}")
+    math(EXPR limit "${TOLERANCE} * 100")
+    if(change GREATER limit)
+      math(EXPR percent "${change} / 100")
+      message(STATUS "REGRESSION ${name} ${metric}: ${before} -> ${now} "
+                     "(+${percent}%)")
+      math(EXPR failures "${failures} + 1")
+    endif()
+  endforeach()
+endforeach()
+
+if(failures GREATER 0)
+  message(FATAL_ERROR "${failures} benchmark metric(s) regressed by more "
+                      "than ${TOLERANCE}%")
+endif()
+message(STATUS "No regressions beyond ${TOLERANCE}% against ${BASELINE}")
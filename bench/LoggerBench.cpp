@@ -0,0 +1,259 @@
+// Benchmarks for the Logger: what a call or a profiling zone costs the
+// producer, with latency percentiles, and how fast the worker drains into a
+// sink.
+//
+//   logger_bench --benchmark_out=results.json --benchmark_out_format=json
+//
+// Console output goes to a sink that discards it and FLOG_* messages go to
+// /dev/null unless a benchmark says otherwise, so producer numbers are not
+// bound by terminal I/O.
+
+#include "LogSinks.hpp"
+#include "Logger.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace bb::core;
+
+// Accepts everything and writes nothing, so the worker only pays for its own
+// loop.
+class NullSink final : public Sink {
+public:
+  using Sink::Sink;
+
+  inline void Write(const LogRecord &) override {}
+  inline bool NeedsText() const noexcept override { return false; }
+};
+
+TickClock &benchClock() {
+  static TickClock clock = [] {
+    TickClock calibrated;
+    calibrated.Calibrate();
+    return calibrated;
+  }();
+  return clock;
+}
+
+// What the logged arguments look like.
+enum class Payload {
+  None,
+  Int,
+  Mixed,
+  String16,
+  String256,
+  String4096,
+};
+
+const std::string &text(size_t size) {
+  static const std::string text(4096, 'x');
+  static const std::string short16 = text.substr(0, 16);
+  static const std::string medium256 = text.substr(0, 256);
+  return size <= 16 ? short16 : size <= 256 ? medium256 : text;
+}
+
+template <bool ToFile, Payload P> inline void logOnce(int64 i) {
+  if constexpr (P == Payload::None) {
+    if constexpr (ToFile)
+      FLOG_INFO("frame done");
+    else
+      LOG_INFO("frame done");
+  } else if constexpr (P == Payload::Int) {
+    if constexpr (ToFile)
+      FLOG_INFO("frame {}", i);
+    else
+      LOG_INFO("frame {}", i);
+  } else if constexpr (P == Payload::Mixed) {
+    const std::string_view name = text(16);
+    if constexpr (ToFile)
+      FLOG_INFO("entity {} '{}' at {:.3f}", i, name, 0.5 * i);
+    else
+      LOG_INFO("entity {} '{}' at {:.3f}", i, name, 0.5 * i);
+  } else {
+    constexpr size_t SIZE = P == Payload::String16    ? 16
+                            : P == Payload::String256 ? 256
+                                                      : 4096;
+    const std::string_view str = text(SIZE);
+    if constexpr (ToFile)
+      FLOG_INFO("payload {}", str);
+    else
+      LOG_INFO("payload {}", str);
+  }
+}
+
+// Waits until the worker has handed `target` messages to the sinks.
+void waitForWorker(uint64 target) {
+  while (Logger::Self().Stats().written < target)
+    std::this_thread::yield();
+}
+
+// Per-call latency. range(0) toggles deferred formatting. Each thread times
+// every call with the TSC and reports its own percentiles; with several
+// threads the counters are their average.
+template <bool ToFile, Payload P> void BM_Call(benchmark::State &state) {
+  Logger &logger = Logger::Self();
+  if (state.thread_index() == 0)
+    logger.SetDeferredFormatting(state.range(0) != 0);
+
+  std::vector<uint64> samples;
+  samples.reserve(static_cast<size_t>(state.max_iterations));
+  int64 i = 0;
+  for (auto _ : state) {
+    const uint64 start = detail::tick();
+    logOnce<ToFile, P>(i++);
+    samples.push_back(detail::tick() - start);
+  }
+
+  std::sort(samples.begin(), samples.end());
+  const float64 nsPerTick = benchClock().NsPerTick();
+  const auto percentile = [&](float64 q) {
+    const auto index = static_cast<size_t>(q * (samples.size() - 1));
+    return static_cast<float64>(samples[index]) * nsPerTick;
+  };
+  if (!samples.empty()) {
+    state.counters["p50_ns"] =
+        benchmark::Counter(percentile(0.50), benchmark::Counter::kAvgThreads);
+    state.counters["p99_ns"] =
+        benchmark::Counter(percentile(0.99), benchmark::Counter::kAvgThreads);
+    state.counters["p99.9_ns"] =
+        benchmark::Counter(percentile(0.999), benchmark::Counter::kAvgThreads);
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  // Keep backlog from one run out of the next one's numbers.
+  if (state.thread_index() == 0)
+    waitForWorker(logger.Stats().enqueued);
+}
+
+// Cost of a PROFILE_SCOPE zone; range(0) toggles profiling, so 0 measures
+// the disabled check alone.
+void BM_ProfileScope(benchmark::State &state) {
+  Logger &logger = Logger::Self();
+  if (state.thread_index() == 0)
+    logger.EnableProfiling(state.range(0) != 0);
+
+  for (auto _ : state) {
+    PROFILE_SCOPE("bench zone");
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    waitForWorker(logger.Stats().enqueued);
+    logger.EnableProfiling(false);
+  }
+}
+
+// Where the throughput benchmark's messages end up.
+enum class Target {
+  Null,    // NullSink: the worker loop alone.
+  DevNull, // FileSink on /dev/null: formatting and write(2).
+  File,    // FileSink on a real file.
+};
+
+// Sustained worker throughput: one producer queues range(0) messages per
+// iteration and the iteration ends once the worker has written them all.
+template <Target T> void BM_WorkerThroughput(benchmark::State &state) {
+  Logger &logger = Logger::Self();
+  logger.SetDeferredFormatting(true);
+
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "logger_bench.log";
+  if constexpr (T == Target::File) {
+    logger.EnableFileLogging(false);
+    std::filesystem::remove(path);
+    logger.SetLogfilePath(path);
+    logger.EnableFileLogging(true);
+  }
+
+  const int64 count = state.range(0);
+  for (auto _ : state) {
+    const uint64 target = logger.Stats().written + count;
+    for (int64 i = 0; i < count; ++i) {
+      if constexpr (T == Target::Null)
+        logOnce<false, Payload::Mixed>(i);
+      else
+        logOnce<true, Payload::Mixed>(i);
+    }
+    waitForWorker(target);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+
+  if constexpr (T == Target::File) {
+    logger.EnableFileLogging(false);
+    logger.SetLogfilePath("/dev/null");
+    logger.EnableFileLogging(true);
+    std::filesystem::remove(path);
+  }
+}
+
+void configureLogger() {
+  Logger &logger = Logger::Self();
+  logger.RemoveSink(logger.DefaultConsoleSink());
+  logger.AddSink(std::make_shared<NullSink>(SinkRoute::Console));
+  logger.SetLogfilePath("/dev/null");
+  logger.EnableFileLogging(true);
+  benchClock();
+}
+
+#define BB_BENCH_CALL(toFile, payload)                                         \
+  BENCHMARK(BM_Call<toFile, payload>)                                          \
+      ->ArgName("deferred")                                                    \
+      ->Arg(0)                                                                 \
+      ->Arg(1)                                                                 \
+      ->ThreadRange(1, 32)                                                     \
+      ->UseRealTime()
+
+BB_BENCH_CALL(false, Payload::None);
+BB_BENCH_CALL(false, Payload::Int);
+BB_BENCH_CALL(false, Payload::Mixed);
+BB_BENCH_CALL(false, Payload::String16);
+BB_BENCH_CALL(false, Payload::String256);
+BB_BENCH_CALL(false, Payload::String4096);
+BB_BENCH_CALL(true, Payload::None);
+BB_BENCH_CALL(true, Payload::Int);
+BB_BENCH_CALL(true, Payload::Mixed);
+BB_BENCH_CALL(true, Payload::String16);
+BB_BENCH_CALL(true, Payload::String256);
+BB_BENCH_CALL(true, Payload::String4096);
+
+BENCHMARK(BM_ProfileScope)
+    ->ArgName("profiling")
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+
+BENCHMARK(BM_WorkerThroughput<Target::Null>)
+    ->Arg(100'000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_WorkerThroughput<Target::DevNull>)
+    ->Arg(100'000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_WorkerThroughput<Target::File>)
+    ->Arg(100'000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+
+  configureLogger();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
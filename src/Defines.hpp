@@ -1,12 +1,16 @@
 #ifndef _GENERIC_DEFINES_HPP
 #define _GENERIC_DEFINES_HPP
 
+#include "FlatMap.hpp"
+
 #include <cstdint>
 #include <format>
 #include <memory>
+#include <memory_resource>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 using string = std::string;
 
@@ -35,4 +39,27 @@ using umap = std::unordered_map<Args...>;
 template <typename ...Args>
 using uset = std::unordered_set<Args...>;
 
+// Open-addressing alternatives to umap/uset: faster lookups, but references
+// and iterators do not survive a rehash.
+template <typename ...Args>
+using fmap = bb::core::FlatMap<Args...>;
+
+template <typename ...Args>
+using fset = bb::core::FlatSet<Args...>;
+
+// Containers drawing from a std::pmr::memory_resource, e.g. the arenas and
+// pools in Memory.hpp.
+using pmr_string = std::pmr::string;
+
+template <typename T>
+using pmr_vector = std::pmr::vector<T>;
+
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename Eq = std::equal_to<K>>
+using pmr_umap = std::pmr::unordered_map<K, V, Hash, Eq>;
+
+template <typename T, typename Hash = std::hash<T>,
+          typename Eq = std::equal_to<T>>
+using pmr_uset = std::pmr::unordered_set<T, Hash, Eq>;
+
 #endif // _GENERIC_DEFINES_HPP
@@ -0,0 +1,743 @@
+#ifndef _GENERIC_FLAT_MAP_HPP
+#define _GENERIC_FLAT_MAP_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) ||              \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BB_FLAT_MAP_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace bb::core {
+
+// Default hasher for FlatMap/FlatSet. String keys hash through string_view,
+// which lets them be looked up by string_view or const char* without
+// building a std::string.
+template <typename T> struct FlatHash : std::hash<T> {};
+
+template <> struct FlatHash<std::string> {
+  using is_transparent = void;
+  inline size_t operator()(std::string_view str) const noexcept {
+    return std::hash<std::string_view>{}(str);
+  }
+};
+
+template <typename T> struct FlatEq : std::equal_to<T> {};
+template <> struct FlatEq<std::string> : std::equal_to<> {};
+
+namespace detail {
+
+// Control bytes: one per slot, holding either a marker or the low seven bits
+// of the slot's hash, so most probes are decided without touching the keys.
+using ctrl_t = int8_t;
+inline constexpr ctrl_t CTRL_EMPTY = -128;
+inline constexpr ctrl_t CTRL_DELETED = -2;
+inline constexpr size_t GROUP_WIDTH = 16;
+
+// Sixteen control bytes compared at once, with SSE2 when available.
+class CtrlGroup {
+public:
+  inline explicit CtrlGroup(const ctrl_t *ctrl) noexcept {
+#ifdef BB_FLAT_MAP_HAS_SSE2
+    _ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+#else
+    std::memcpy(_ctrl, ctrl, GROUP_WIDTH);
+#endif
+  }
+
+  // One bit per slot whose control byte equals `h2`.
+  inline uint32_t Match(ctrl_t h2) const noexcept {
+#ifdef BB_FLAT_MAP_HAS_SSE2
+    return static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), _ctrl)));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < GROUP_WIDTH; ++i)
+      bits |= static_cast<uint32_t>(_ctrl[i] == h2) << i;
+    return bits;
+#endif
+  }
+
+  inline uint32_t MatchEmpty() const noexcept { return Match(CTRL_EMPTY); }
+
+  // Both markers are negative and below every other negative value in use.
+  inline uint32_t MatchEmptyOrDeleted() const noexcept {
+#ifdef BB_FLAT_MAP_HAS_SSE2
+    return static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_cmpgt_epi8(_mm_set1_epi8(CTRL_DELETED + 1), _ctrl)));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < GROUP_WIDTH; ++i)
+      bits |= static_cast<uint32_t>(_ctrl[i] <= CTRL_DELETED) << i;
+    return bits;
+#endif
+  }
+
+private:
+#ifdef BB_FLAT_MAP_HAS_SSE2
+  __m128i _ctrl;
+#else
+  ctrl_t _ctrl[GROUP_WIDTH];
+#endif
+};
+
+// std::hash is the identity for integers; spread the bits before splitting
+// the hash into a probe start (h1) and a control byte (h2).
+inline constexpr size_t mixHash(size_t hash) noexcept {
+  const uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+  return static_cast<size_t>(mixed ^ (mixed >> 32));
+}
+
+template <typename K, typename V> struct FlatMapPolicy {
+  using key_type = K;
+  using value_type = std::pair<const K, V>;
+  static constexpr bool CONST_VALUES = false;
+
+  static inline const K &Key(const value_type &value) noexcept {
+    return value.first;
+  }
+
+  // Moves the key too: the slot it came from is destroyed right after.
+  static inline void Transfer(value_type *to, value_type *from) {
+    ::new (to) value_type(std::move(const_cast<K &>(from->first)),
+                          std::move(from->second));
+    from->~value_type();
+  }
+};
+
+template <typename K> struct FlatSetPolicy {
+  using key_type = K;
+  using value_type = K;
+  static constexpr bool CONST_VALUES = true;
+
+  static inline const K &Key(const value_type &value) noexcept {
+    return value;
+  }
+
+  static inline void Transfer(value_type *to, value_type *from) {
+    ::new (to) value_type(std::move(*from));
+    from->~value_type();
+  }
+};
+
+// Open-addressing table in the Swiss-table style: slots live in one flat
+// array, probed a group of sixteen at a time, and stay at most 7/8 full.
+template <typename Policy, typename Hash, typename Eq> class FlatTable {
+public:
+  using key_type = typename Policy::key_type;
+  using value_type = typename Policy::value_type;
+  using size_type = size_t;
+  using difference_type = std::ptrdiff_t;
+  using hasher = Hash;
+  using key_equal = Eq;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+
+  // Lookups accept any key type when both functors are transparent.
+  static constexpr bool IS_TRANSPARENT = requires {
+    typename Hash::is_transparent;
+    typename Eq::is_transparent;
+  };
+
+  template <bool Const> class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename Policy::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::conditional_t<Const || Policy::CONST_VALUES,
+                                         const value_type &, value_type &>;
+    using pointer = std::conditional_t<Const || Policy::CONST_VALUES,
+                                       const value_type *, value_type *>;
+
+    Iterator() = default;
+
+    // A mutable iterator converts to a const one.
+    template <bool OtherConst>
+      requires(Const && !OtherConst)
+    inline Iterator(const Iterator<OtherConst> &other) noexcept
+        : _ctrl(other._ctrl), _slot(other._slot), _end(other._end) {}
+
+    inline reference operator*() const noexcept { return *_slot; }
+    inline pointer operator->() const noexcept { return _slot; }
+
+    inline Iterator &operator++() noexcept {
+      ++_ctrl;
+      ++_slot;
+      skipFree();
+      return *this;
+    }
+
+    inline Iterator operator++(int) noexcept {
+      Iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    template <bool OtherConst>
+    inline bool operator==(const Iterator<OtherConst> &other) const noexcept {
+      return _ctrl == other._ctrl;
+    }
+
+  private:
+    friend class FlatTable;
+    template <bool> friend class Iterator;
+
+    inline Iterator(const ctrl_t *ctrl, value_type *slot,
+                    const ctrl_t *end) noexcept
+        : _ctrl(ctrl), _slot(slot), _end(end) {}
+
+    inline void skipFree() noexcept {
+      while (_ctrl != _end && *_ctrl < 0) {
+        ++_ctrl;
+        ++_slot;
+      }
+    }
+
+    const ctrl_t *_ctrl = nullptr;
+    value_type *_slot = nullptr;
+    const ctrl_t *_end = nullptr;
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  FlatTable() = default;
+
+  inline explicit FlatTable(size_t bucketCount, const Hash &hash = Hash(),
+                            const Eq &eq = Eq())
+      : _hash(hash), _eq(eq) {
+    reserve(bucketCount);
+  }
+
+  inline FlatTable(const FlatTable &other)
+      : _hash(other._hash), _eq(other._eq) {
+    reserve(other._size);
+    for (const value_type &value : other)
+      insertUnique(value);
+  }
+
+  inline FlatTable(FlatTable &&other) noexcept
+      : _ctrl(std::exchange(other._ctrl, nullptr)),
+        _slots(std::exchange(other._slots, nullptr)),
+        _capacity(std::exchange(other._capacity, 0)),
+        _size(std::exchange(other._size, 0)),
+        _growthLeft(std::exchange(other._growthLeft, 0)),
+        _hash(std::move(other._hash)), _eq(std::move(other._eq)) {}
+
+  inline FlatTable &operator=(const FlatTable &other) {
+    if (this != &other) {
+      FlatTable copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  inline FlatTable &operator=(FlatTable &&other) noexcept {
+    if (this != &other) {
+      FlatTable moved(std::move(other));
+      swap(moved);
+    }
+    return *this;
+  }
+
+  inline ~FlatTable() { destroy(); }
+
+  inline iterator begin() noexcept {
+    iterator it(_ctrl, _slots, _ctrl + _capacity);
+    it.skipFree();
+    return it;
+  }
+  inline const_iterator begin() const noexcept {
+    return const_cast<FlatTable *>(this)->begin();
+  }
+  inline const_iterator cbegin() const noexcept { return begin(); }
+
+  inline iterator end() noexcept {
+    return iterator(_ctrl + _capacity, _slots + _capacity, _ctrl + _capacity);
+  }
+  inline const_iterator end() const noexcept {
+    return const_cast<FlatTable *>(this)->end();
+  }
+  inline const_iterator cend() const noexcept { return end(); }
+
+  inline bool empty() const noexcept { return _size == 0; }
+  inline size_t size() const noexcept { return _size; }
+  inline size_t capacity() const noexcept { return _capacity; }
+  inline float load_factor() const noexcept {
+    return _capacity ? static_cast<float>(_size) / _capacity : 0.0f;
+  }
+  inline hasher hash_function() const { return _hash; }
+  inline key_equal key_eq() const { return _eq; }
+
+  inline void clear() noexcept {
+    if (_capacity == 0)
+      return;
+
+    destroySlots();
+    std::memset(_ctrl, CTRL_EMPTY, _capacity + GROUP_WIDTH);
+    _size = 0;
+    _growthLeft = maxLoad(_capacity);
+  }
+
+  // Makes room for `count` elements without further rehashing.
+  inline void reserve(size_t count) {
+    if (count > _size + _growthLeft)
+      resize(capacityFor(count));
+  }
+
+  inline void rehash(size_t count) {
+    resize(capacityFor(std::max(count, _size)));
+  }
+
+  inline void swap(FlatTable &other) noexcept {
+    using std::swap;
+    swap(_ctrl, other._ctrl);
+    swap(_slots, other._slots);
+    swap(_capacity, other._capacity);
+    swap(_size, other._size);
+    swap(_growthLeft, other._growthLeft);
+    swap(_hash, other._hash);
+    swap(_eq, other._eq);
+  }
+
+  inline std::pair<iterator, bool> insert(const value_type &value) {
+    return emplaceKey(Policy::Key(value), value);
+  }
+
+  inline std::pair<iterator, bool> insert(value_type &&value) {
+    return emplaceKey(Policy::Key(value), std::move(value));
+  }
+
+  template <typename InputIt> inline void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+
+  inline void insert(std::initializer_list<value_type> values) {
+    insert(values.begin(), values.end());
+  }
+
+  template <typename... Args>
+  inline std::pair<iterator, bool> emplace(Args &&...args) {
+    // The key is only known once the value exists.
+    alignas(value_type) std::byte storage[sizeof(value_type)];
+    auto *value = ::new (storage) value_type(std::forward<Args>(args)...);
+    const size_t hash = mixHash(_hash(Policy::Key(*value)));
+    std::pair<size_t, bool> slot;
+    try {
+      slot = findOrPrepareInsert(Policy::Key(*value), hash);
+    } catch (...) {
+      value->~value_type();
+      throw;
+    }
+    if (slot.second)
+      Policy::Transfer(_slots + slot.first, value);
+    else
+      value->~value_type();
+    return {iteratorAt(slot.first), slot.second};
+  }
+
+  inline iterator find(const key_type &key) noexcept { return findKey(key); }
+
+  template <typename K>
+    requires IS_TRANSPARENT
+  inline iterator find(const K &key) noexcept {
+    return findKey(key);
+  }
+
+  inline const_iterator find(const key_type &key) const noexcept {
+    return const_cast<FlatTable *>(this)->findKey(key);
+  }
+
+  template <typename K>
+    requires IS_TRANSPARENT
+  inline const_iterator find(const K &key) const noexcept {
+    return const_cast<FlatTable *>(this)->findKey(key);
+  }
+
+  inline bool contains(const key_type &key) const noexcept {
+    return findIndex(key) != NPOS;
+  }
+
+  template <typename K>
+    requires IS_TRANSPARENT
+  inline bool contains(const K &key) const noexcept {
+    return findIndex(key) != NPOS;
+  }
+
+  inline size_t count(const key_type &key) const noexcept {
+    return contains(key) ? 1 : 0;
+  }
+
+  template <typename K>
+    requires IS_TRANSPARENT
+  inline size_t count(const K &key) const noexcept {
+    return contains(key) ? 1 : 0;
+  }
+
+  inline size_t erase(const key_type &key) { return eraseKey(key); }
+
+  template <typename K>
+    requires IS_TRANSPARENT && (!std::is_convertible_v<K, const_iterator>)
+  inline size_t erase(const K &key) {
+    return eraseKey(key);
+  }
+
+  inline iterator erase(const_iterator pos) {
+    const size_t index = static_cast<size_t>(pos._ctrl - _ctrl);
+    eraseAt(index);
+    iterator next = iteratorAt(index);
+    next.skipFree();
+    return next;
+  }
+
+  inline iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+  inline bool operator==(const FlatTable &other) const {
+    if (_size != other._size)
+      return false;
+    for (const value_type &value : *this) {
+      const auto it = other.find(Policy::Key(value));
+      if (it == other.end() || !(*it == value))
+        return false;
+    }
+    return true;
+  }
+
+protected:
+  static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+  template <typename K> inline iterator findKey(const K &key) noexcept {
+    const size_t index = findIndex(key);
+    return index == NPOS ? end() : iteratorAt(index);
+  }
+
+  template <typename K> inline size_t eraseKey(const K &key) {
+    const size_t index = findIndex(key);
+    if (index == NPOS)
+      return 0;
+    eraseAt(index);
+    return 1;
+  }
+
+  template <typename K, typename... Args>
+  inline std::pair<iterator, bool> emplaceKey(const K &key, Args &&...args) {
+    const auto [index, inserted] =
+        findOrPrepareInsert(key, mixHash(_hash(key)));
+    if (inserted)
+      constructAt(index, std::forward<Args>(args)...);
+    return {iteratorAt(index), inserted};
+  }
+
+  template <typename K>
+  inline std::pair<size_t, bool> findOrPrepareInsert(const K &key,
+                                                     size_t hash) {
+    const size_t index = findIndex(key, hash);
+    if (index != NPOS)
+      return {index, false};
+    return {prepareInsert(hash), true};
+  }
+
+  template <typename... Args>
+  inline void constructAt(size_t index, Args &&...args) {
+    try {
+      ::new (_slots + index) value_type(std::forward<Args>(args)...);
+    } catch (...) {
+      setCtrl(index, CTRL_DELETED);
+      --_size;
+      throw;
+    }
+  }
+
+  inline iterator iteratorAt(size_t index) noexcept {
+    return iterator(_ctrl + index, _slots + index, _ctrl + _capacity);
+  }
+
+  template <typename K> inline size_t findIndex(const K &key) const noexcept {
+    return findIndex(key, mixHash(_hash(key)));
+  }
+
+  template <typename K>
+  inline size_t findIndex(const K &key, size_t hash) const noexcept {
+    if (_capacity == 0)
+      return NPOS;
+
+    const ctrl_t h2 = static_cast<ctrl_t>(hash & 0x7F);
+    const size_t mask = _capacity - 1;
+    size_t pos = (hash >> 7) & mask;
+    for (size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+      const CtrlGroup group(_ctrl + pos);
+      for (uint32_t bits = group.Match(h2); bits; bits &= bits - 1) {
+        const size_t index = (pos + std::countr_zero(bits)) & mask;
+        if (_eq(Policy::Key(_slots[index]), key))
+          return index;
+      }
+      if (group.MatchEmpty())
+        return NPOS;
+      pos = (pos + step) & mask;
+    }
+  }
+
+  // Claims a free slot for `hash`, growing first if the table is full.
+  inline size_t prepareInsert(size_t hash) {
+    size_t index = findFree(hash);
+    if (_capacity == 0 || (_growthLeft == 0 && _ctrl[index] != CTRL_DELETED)) {
+      // Mostly tombstones: rebuild at the same size rather than doubling.
+      const bool crowded = _size * 32 > maxLoad(_capacity) * 25;
+      resize(crowded || _capacity == 0 ? growCapacity() : _capacity);
+      index = findFree(hash);
+    }
+
+    _growthLeft -= _ctrl[index] == CTRL_EMPTY;
+    setCtrl(index, static_cast<ctrl_t>(hash & 0x7F));
+    ++_size;
+    return index;
+  }
+
+  inline size_t findFree(size_t hash) const noexcept {
+    if (_capacity == 0)
+      return 0;
+
+    const size_t mask = _capacity - 1;
+    size_t pos = (hash >> 7) & mask;
+    for (size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+      const uint32_t bits = CtrlGroup(_ctrl + pos).MatchEmptyOrDeleted();
+      if (bits)
+        return (pos + std::countr_zero(bits)) & mask;
+      pos = (pos + step) & mask;
+    }
+  }
+
+  inline void eraseAt(size_t index) {
+    _slots[index].~value_type();
+    setCtrl(index, CTRL_DELETED);
+    --_size;
+  }
+
+  // The first group is mirrored after the last slot, so a group load never
+  // has to wrap around.
+  inline void setCtrl(size_t index, ctrl_t value) noexcept {
+    _ctrl[index] = value;
+    if (index < GROUP_WIDTH)
+      _ctrl[_capacity + index] = value;
+  }
+
+  // Moves every element into a table of `capacity` slots.
+  inline void resize(size_t capacity) {
+    ctrl_t *oldCtrl = _ctrl;
+    value_type *oldSlots = _slots;
+    const size_t oldCapacity = _capacity;
+    if (capacity == 0) {
+      // Only reachable when empty: drop the storage altogether.
+      release(oldCtrl, oldSlots, oldCapacity);
+      _ctrl = nullptr;
+      _slots = nullptr;
+      _capacity = 0;
+      _growthLeft = 0;
+      return;
+    }
+
+    _ctrl = static_cast<ctrl_t *>(::operator new(capacity + GROUP_WIDTH));
+    try {
+      _slots = static_cast<value_type *>(
+          ::operator new(capacity * sizeof(value_type),
+                         std::align_val_t(alignof(value_type))));
+    } catch (...) {
+      ::operator delete(_ctrl);
+      _ctrl = oldCtrl;
+      throw;
+    }
+    std::memset(_ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+    _capacity = capacity;
+    _growthLeft = maxLoad(capacity) - _size;
+
+    for (size_t i = 0; i < oldCapacity; ++i) {
+      if (oldCtrl[i] < 0)
+        continue;
+      const size_t hash = mixHash(_hash(Policy::Key(oldSlots[i])));
+      const size_t index = findFree(hash);
+      setCtrl(index, static_cast<ctrl_t>(hash & 0x7F));
+      Policy::Transfer(_slots + index, oldSlots + i);
+    }
+    release(oldCtrl, oldSlots, oldCapacity);
+  }
+
+  template <typename V> inline void insertUnique(V &&value) {
+    const size_t hash = mixHash(_hash(Policy::Key(value)));
+    constructAt(prepareInsert(hash), std::forward<V>(value));
+  }
+
+  inline void destroySlots() noexcept {
+    if constexpr (!std::is_trivially_destructible_v<value_type>) {
+      for (size_t i = 0; i < _capacity; ++i) {
+        if (_ctrl[i] >= 0)
+          _slots[i].~value_type();
+      }
+    }
+  }
+
+  inline void destroy() noexcept {
+    destroySlots();
+    release(_ctrl, _slots, _capacity);
+  }
+
+  static inline void release(ctrl_t *ctrl, value_type *slots,
+                             size_t capacity) noexcept {
+    if (capacity == 0)
+      return;
+    ::operator delete(ctrl);
+    ::operator delete(slots, std::align_val_t(alignof(value_type)));
+  }
+
+  static inline constexpr size_t maxLoad(size_t capacity) noexcept {
+    return capacity - capacity / 8;
+  }
+
+  static inline size_t capacityFor(size_t count) noexcept {
+    if (count == 0)
+      return 0;
+    const size_t needed = count + (count + 6) / 7; // count / (7/8)
+    return std::bit_ceil(std::max(needed, GROUP_WIDTH));
+  }
+
+  inline size_t growCapacity() const noexcept {
+    return _capacity ? _capacity * 2 : GROUP_WIDTH;
+  }
+
+  ctrl_t *_ctrl = nullptr;
+  value_type *_slots = nullptr;
+  size_t _capacity = 0;
+  size_t _size = 0;
+  size_t _growthLeft = 0;
+  [[no_unique_address]] Hash _hash{};
+  [[no_unique_address]] Eq _eq{};
+};
+
+} // namespace detail
+
+// Flat hash map, mostly a drop-in for std::unordered_map. References and
+// iterators are invalidated by any insertion that grows the table, and
+// there is no bucket interface.
+template <typename K, typename V, typename Hash = FlatHash<K>,
+          typename Eq = FlatEq<K>>
+class FlatMap
+    : public detail::FlatTable<detail::FlatMapPolicy<K, V>, Hash, Eq> {
+  using Base = detail::FlatTable<detail::FlatMapPolicy<K, V>, Hash, Eq>;
+
+public:
+  using mapped_type = V;
+  using typename Base::const_iterator;
+  using typename Base::iterator;
+  using typename Base::key_type;
+  using typename Base::value_type;
+
+  using Base::Base;
+
+  inline FlatMap(std::initializer_list<value_type> values) {
+    this->reserve(values.size());
+    this->insert(values);
+  }
+
+  template <typename... Args>
+  inline std::pair<iterator, bool> try_emplace(const key_type &key,
+                                               Args &&...args) {
+    return this->emplaceKey(key, std::piecewise_construct,
+                            std::forward_as_tuple(key),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  template <typename... Args>
+  inline std::pair<iterator, bool> try_emplace(key_type &&key,
+                                               Args &&...args) {
+    return this->emplaceKey(key, std::piecewise_construct,
+                            std::forward_as_tuple(std::move(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  template <typename M>
+  inline std::pair<iterator, bool> insert_or_assign(const key_type &key,
+                                                    M &&value) {
+    auto result = try_emplace(key, std::forward<M>(value));
+    if (!result.second)
+      result.first->second = std::forward<M>(value);
+    return result;
+  }
+
+  template <typename M>
+  inline std::pair<iterator, bool> insert_or_assign(key_type &&key,
+                                                    M &&value) {
+    auto result = try_emplace(std::move(key), std::forward<M>(value));
+    if (!result.second)
+      result.first->second = std::forward<M>(value);
+    return result;
+  }
+
+  inline V &operator[](const key_type &key) {
+    return try_emplace(key).first->second;
+  }
+
+  inline V &operator[](key_type &&key) {
+    return try_emplace(std::move(key)).first->second;
+  }
+
+  inline V &at(const key_type &key) { return atKey(key); }
+
+  template <typename L>
+    requires Base::IS_TRANSPARENT
+  inline V &at(const L &key) {
+    return atKey(key);
+  }
+
+  inline const V &at(const key_type &key) const {
+    return const_cast<FlatMap *>(this)->atKey(key);
+  }
+
+  template <typename L>
+    requires Base::IS_TRANSPARENT
+  inline const V &at(const L &key) const {
+    return const_cast<FlatMap *>(this)->atKey(key);
+  }
+
+private:
+  template <typename L> inline V &atKey(const L &key) {
+    const auto it = this->findKey(key);
+    if (it == this->end())
+      throw std::out_of_range("FlatMap::at: key not found");
+    return it->second;
+  }
+};
+
+// Flat hash set, mostly a drop-in for std::unordered_set. Elements are
+// immutable through iterators.
+template <typename T, typename Hash = FlatHash<T>, typename Eq = FlatEq<T>>
+class FlatSet : public detail::FlatTable<detail::FlatSetPolicy<T>, Hash, Eq> {
+  using Base = detail::FlatTable<detail::FlatSetPolicy<T>, Hash, Eq>;
+
+public:
+  using typename Base::value_type;
+
+  using Base::Base;
+
+  inline FlatSet(std::initializer_list<value_type> values) {
+    this->reserve(values.size());
+    this->insert(values);
+  }
+};
+
+} // namespace bb::core
+
+#endif // _GENERIC_FLAT_MAP_HPP
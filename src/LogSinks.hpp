@@ -0,0 +1,1065 @@
+#ifndef _GENERIC_LOG_SINKS_HPP
+#define _GENERIC_LOG_SINKS_HPP
+
+#include "Logger.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BB_LOG_HAS_MMAP 1
+#define BB_LOG_HAS_SOCKETS 1
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace bb::core {
+
+// Keeps the last `capacity` formatted lines in memory, e.g. to attach recent
+// history to a crash report or to inspect output in tests.
+class MemorySink : public Sink {
+public:
+  inline explicit MemorySink(size_t capacity,
+                             SinkRoute route = SinkRoute::Console)
+      : Sink(route), _capacity(capacity > 0 ? capacity : 1) {}
+
+  inline void Write(const LogRecord &record) override {
+    _line.clear();
+    format(record, _line);
+
+    std::lock_guard lock(_mutex);
+    if (_lines.size() == _capacity)
+      _lines.pop_front();
+    _lines.push_back(_line);
+  }
+
+  // Safe to call from any thread; oldest line first.
+  inline std::vector<string> Snapshot() const {
+    std::lock_guard lock(_mutex);
+    return {_lines.begin(), _lines.end()};
+  }
+
+  inline void Clear() {
+    std::lock_guard lock(_mutex);
+    _lines.clear();
+  }
+
+private:
+  size_t _capacity;
+  string _line;
+  mutable std::mutex _mutex;
+  std::deque<string> _lines;
+};
+
+// Hands every record, along with its formatted line, to a user callback.
+class CallbackSink : public Sink {
+public:
+  using Callback =
+      std::function<void(const LogRecord &record, std::string_view line)>;
+
+  inline explicit CallbackSink(Callback callback,
+                               SinkRoute route = SinkRoute::Console)
+      : Sink(route), _callback(std::move(callback)) {}
+
+  inline void Write(const LogRecord &record) override {
+    _line.clear();
+    format(record, _line);
+    _callback(record, _line);
+  }
+
+private:
+  Callback _callback;
+  string _line;
+};
+
+namespace detail {
+
+// Encodes records in the binary log layout (see BinaryLogRecord). Each call
+// site's dictionary entry is emitted the first time it is seen since the
+// last Begin().
+class BinaryLogEncoder {
+public:
+  // Starts a session: later records only refer to sites emitted after it.
+  inline void Begin(string &out) {
+    _siteIds.clear();
+    put(out, BinaryLogRecord::Session);
+    out.append(LOG_BINARY_MAGIC);
+    put(out, LOG_BINARY_VERSION);
+  }
+
+  // Site records it emits are copied to `sites` as well, if given.
+  inline void Append(const LogRecord &record, string &out,
+                     string *sites = nullptr) {
+    const size_t before = out.size();
+    const uint32 id = siteId(record, out);
+    if (sites)
+      sites->append(out, before, out.size() - before);
+    const bool raw = record.args && record.codec->portable;
+    const int64 nanos =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            record.time.time_since_epoch())
+            .count();
+    const uint8 flags = static_cast<uint8>(
+        (raw ? LOG_BINARY_RAW_ARGS : 0) |
+        (record.suppressed > 0 ? LOG_BINARY_SUPPRESSED : 0) |
+        (static_cast<uint8>(record.precision) << LOG_BINARY_PRECISION_SHIFT));
+
+    put(out, BinaryLogRecord::Message);
+    put(out, id);
+    put(out, nanos);
+    put(out, flags);
+    if (record.suppressed > 0)
+      put(out, record.suppressed);
+    if (raw)
+      putString(out, {reinterpret_cast<const char *>(record.args),
+                      record.argBytes});
+    else
+      putString(out, record.payload);
+  }
+
+private:
+  inline uint32 siteId(const LogRecord &record, string &out) {
+    const auto [it, inserted] = _siteIds.try_emplace(
+        record.site, static_cast<uint32>(_siteIds.size()));
+    if (!inserted)
+      return it->second;
+
+    const LogSite &site = *record.site;
+    put(out, BinaryLogRecord::Site);
+    put(out, it->second);
+    put(out, static_cast<uint8>(site.level));
+    put(out, site.line);
+    putString(out, site.fmt);
+    putString(out, site.file);
+    putString(out, site.function);
+    put(out, static_cast<uint8>(record.codec->count));
+    for (uint32 i = 0; i < record.codec->count; ++i)
+      put(out, record.codec->types[i]);
+    putString(out,
+              site.category ? site.category->Name() : std::string_view());
+    return it->second;
+  }
+
+  template <typename T> static inline void put(string &out, const T &value) {
+    const size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+  }
+
+  static inline void putString(string &out, std::string_view str) {
+    put(out, static_cast<uint32>(str.size()));
+    out.append(str);
+  }
+
+  fmap<const LogSite *, uint32> _siteIds;
+};
+
+} // namespace detail
+
+// Writes records in the binary log layout (see BinaryLogRecord) instead of
+// text. Messages whose arguments were captured (see SetDeferredFormatting)
+// are stored raw and never formatted in-process; the rest are stored as text.
+class BinaryFileSink : public Sink {
+public:
+  inline explicit BinaryFileSink(const std::filesystem::path &path,
+                                 SinkRoute route = SinkRoute::File)
+      : Sink(route), _path(path),
+        _file(std::fopen(path.string().c_str(), "ab")) {
+    if (!_file)
+      return;
+
+    std::setvbuf(_file, nullptr, _IONBF, 0);
+    _encoder.Begin(_batch);
+  }
+
+  inline ~BinaryFileSink() override {
+    Flush();
+    if (_index) {
+      _index->Finish(_written);
+      _index->Flush();
+    }
+    if (_file)
+      std::fclose(_file);
+  }
+
+  inline bool IsOpen() const noexcept { return _file != nullptr; }
+
+  // Writes a side index next to the file, one entry per `interval` records
+  // (see LogIndexEntry). Each block then starts a session of its own, so a
+  // reader can decode from any entry. Call it before registering the sink.
+  inline void EnableIndex(uint32 interval = LOG_INDEX_INTERVAL) {
+    std::error_code error;
+    const uintmax_t size = std::filesystem::file_size(_path, error);
+    _written = error ? 0 : static_cast<uint64>(size);
+    _sessionStart = _written;
+    _index = std::make_unique<detail::LogIndexWriter>(_path, true, interval);
+  }
+
+  inline bool NeedsText() const noexcept override { return false; }
+
+  inline void Write(const LogRecord &record) override {
+    if (_index) {
+      // The constructor's session starts the first block.
+      const uint64 offset =
+          _sessionOnly ? _sessionStart : _written + _batch.size();
+      if (_index->Add(record, offset) && !_sessionOnly)
+        _encoder.Begin(_batch);
+    }
+    _sessionOnly = false;
+    _encoder.Append(record, _batch);
+    if (_batch.size() >= batchBytes())
+      Flush();
+  }
+
+  inline void Flush() override {
+    if (!_batch.empty()) {
+      if (_file)
+        std::fwrite(_batch.data(), 1, _batch.size(), _file);
+      _written += _batch.size();
+      _batch.clear();
+    }
+    // After the log, so no entry points past its end.
+    if (_index)
+      _index->Flush();
+  }
+
+private:
+  std::filesystem::path _path;
+  std::FILE *_file;
+  string _batch;
+  uint64 _written = 0; // Size of the file, as far as the index knows.
+  uint64 _sessionStart = 0; // Where the constructor's session went.
+  bool _sessionOnly = true;  // No record written since then.
+  detail::BinaryLogEncoder _encoder;
+  uptr<detail::LogIndexWriter> _index;
+};
+
+namespace detail {
+
+// JSON numbers through std::to_chars, into a reused buffer.
+template <typename T> inline void appendJsonNumber(string &out, T value) {
+  if constexpr (std::is_floating_point_v<T>) {
+    if (!std::isfinite(value)) {
+      out += "null";
+      return;
+    }
+  }
+  char buffer[32];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.append(buffer, result.ptr);
+}
+
+template <typename T> inline T readJsonArg(const std::byte *&in) {
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  in += sizeof(T);
+  return value;
+}
+
+// Appends one captured argument of `type` as a JSON value.
+inline void appendJsonArg(string &out, LogArgType type,
+                          const std::byte *&in) {
+  switch (type) {
+  case LogArgType::Bool:
+    out += readJsonArg<bool>(in) ? "true" : "false";
+    break;
+  case LogArgType::Char: {
+    const char c = readJsonArg<char>(in);
+    appendJsonString(out, std::string_view(&c, 1));
+    break;
+  }
+  case LogArgType::Int8:
+    appendJsonNumber(out, readJsonArg<int8>(in));
+    break;
+  case LogArgType::Int16:
+    appendJsonNumber(out, readJsonArg<int16>(in));
+    break;
+  case LogArgType::Int32:
+    appendJsonNumber(out, readJsonArg<int32>(in));
+    break;
+  case LogArgType::Int64:
+    appendJsonNumber(out, readJsonArg<int64>(in));
+    break;
+  case LogArgType::UInt8:
+    appendJsonNumber(out, readJsonArg<uint8>(in));
+    break;
+  case LogArgType::UInt16:
+    appendJsonNumber(out, readJsonArg<uint16>(in));
+    break;
+  case LogArgType::UInt32:
+    appendJsonNumber(out, readJsonArg<uint32>(in));
+    break;
+  case LogArgType::UInt64:
+    appendJsonNumber(out, readJsonArg<uint64>(in));
+    break;
+  case LogArgType::Float32:
+    appendJsonNumber(out, readJsonArg<float32>(in));
+    break;
+  case LogArgType::Float64:
+    appendJsonNumber(out, readJsonArg<float64>(in));
+    break;
+  case LogArgType::String: {
+    const uint32 len = readJsonArg<uint32>(in);
+    appendJsonString(out, {reinterpret_cast<const char *>(in), len});
+    in += len;
+    break;
+  }
+  case LogArgType::Opaque: // Never captured for portable codecs.
+    out += "null";
+    break;
+  }
+}
+
+} // namespace detail
+
+// Writes one JSON object per line, for log ingestion without parsing:
+//   {"time":"...","level":"INFO","file":"game.cpp","line":42,
+//    "function":"...","msg":"spawn","id":7,"x":1.5}
+// Categorised sites (LOG_*_C) add a "category" key after "level". Fields of
+// structured sites (LOG_*_KV) come out typed straight from the captured
+// values; other messages carry their text in "msg", rendered here from the
+// captured arguments when no other sink needed it.
+class JsonLinesSink : public Sink {
+public:
+  inline explicit JsonLinesSink(const std::filesystem::path &path,
+                                SinkRoute route = SinkRoute::File)
+      : Sink(route), _file(std::fopen(path.string().c_str(), "a")) {
+    if (_file)
+      std::setvbuf(_file, nullptr, _IONBF, 0);
+  }
+
+  inline ~JsonLinesSink() override {
+    Flush();
+    if (_file)
+      std::fclose(_file);
+  }
+
+  inline bool IsOpen() const noexcept { return _file != nullptr; }
+
+  inline bool NeedsText() const noexcept override { return false; }
+
+  inline void Write(const LogRecord &record) override {
+    const LogSite &site = *record.site;
+    _batch += "{\"time\":";
+    detail::appendJsonString(
+        _batch, _timestamps.Format(record.time, record.precision));
+    _batch += ",\"level\":";
+    detail::appendJsonString(_batch, site.levelName);
+    if (site.category) {
+      _batch += ",\"category\":";
+      detail::appendJsonString(_batch, site.category->Name());
+    }
+    _batch += ",\"file\":";
+    detail::appendJsonString(_batch, site.file);
+    _batch += ",\"line\":";
+    detail::appendJsonNumber(_batch, site.line);
+    _batch += ",\"function\":";
+    detail::appendJsonString(_batch, site.function);
+    _batch += ",\"msg\":";
+
+    const bool typed = record.args && record.codec->portable;
+    if (site.fields && typed) {
+      detail::appendJsonString(_batch, site.fields->message);
+      const std::byte *in = record.args;
+      for (uint32 i = 0; i < site.fields->count; ++i) {
+        _batch += ',';
+        detail::appendJsonString(_batch, site.fields->keys[i]);
+        _batch += ':';
+        detail::appendJsonArg(_batch, record.codec->types[i], in);
+      }
+    } else if (record.args) {
+      _text.clear();
+      record.codec->format(site, record.args, _text);
+      detail::appendJsonString(_batch, _text);
+    } else {
+      detail::appendJsonString(_batch, record.payload);
+    }
+
+    if (record.suppressed > 0) {
+      _batch += ",\"suppressed\":";
+      detail::appendJsonNumber(_batch, record.suppressed);
+    }
+    _batch += "}\n";
+
+    if (_batch.size() >= batchBytes())
+      Flush();
+  }
+
+  inline void Flush() override {
+    if (_batch.empty())
+      return;
+
+    if (_file)
+      std::fwrite(_batch.data(), 1, _batch.size(), _file);
+    _batch.clear();
+  }
+
+private:
+  std::FILE *_file;
+  string _batch;
+  string _text;
+  TimestampFormatter _timestamps;
+};
+
+#ifdef BB_LOG_HAS_MMAP
+
+struct MappedFileOptions {
+  // Size of a segment. It is allocated and mapped up front, and the sink
+  // rotates once a message no longer fits.
+  size_t maxBytes = 64 * 1024 * 1024;
+  // Also rotate once a segment has been open this long; zero never does.
+  std::chrono::seconds maxAge{0};
+  // Rotated segments to keep, oldest removed first; zero keeps them all.
+  uint32 keepSegments = 8;
+  // How often written pages are synced to disk; zero syncs only on
+  // rotation and close.
+  std::chrono::milliseconds syncInterval{1000};
+  // Run on a background thread for each rotated segment, e.g. to gzip it.
+  // It may replace the file with one whose name extends the segment's.
+  std::function<void(const std::filesystem::path &)> compress;
+};
+
+// Appends by copying into a shared mapping of a pre-allocated file, so a
+// write is a memcpy and the page cache does the rest. Rotated segments are
+// numbered upwards, log.1.txt being the oldest, so that a segment never
+// changes name while it is being compressed.
+class MappedFileSink : public Sink {
+public:
+  inline explicit MappedFileSink(const std::filesystem::path &path,
+                                 MappedFileOptions options = {},
+                                 SinkRoute route = SinkRoute::File)
+      : Sink(route), _path(path), _options(std::move(options)) {
+    if (_options.maxBytes == 0)
+      _options.maxBytes = 1;
+    _nextSegment = lastSegment() + 1;
+    open();
+  }
+
+  inline ~MappedFileSink() override {
+    close();
+    {
+      std::lock_guard lock(_jobsMutex);
+      _stopping = true;
+    }
+    _jobsReady.notify_one();
+    if (_jobThread.joinable())
+      _jobThread.join();
+  }
+
+  inline bool IsOpen() const noexcept { return _map != nullptr; }
+
+  inline void Write(const LogRecord &record) override {
+    _line.clear();
+    format(record, _line);
+    if (!_map)
+      return;
+
+    const auto now = std::chrono::steady_clock::now();
+    const bool expired = _options.maxAge.count() > 0 &&
+                         now - _openedAt >= _options.maxAge;
+    if (expired || _offset + _line.size() > _options.maxBytes) {
+      rotate();
+      if (!_map)
+        return;
+    }
+
+    const size_t size = std::min(_line.size(), _options.maxBytes - _offset);
+    std::memcpy(_map + _offset, _line.data(), size);
+    _offset += size;
+  }
+
+  inline void Flush() override {
+    if (!_map || _options.syncInterval.count() == 0)
+      return;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - _lastSync >= _options.syncInterval)
+      sync();
+  }
+
+private:
+  // Picks up where a previous run left off. After a crash the file still
+  // has its pre-allocated tail of zeros, which is not part of the log.
+  inline void open() {
+    _fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (_fd < 0)
+      return;
+
+    const off_t existing = ::lseek(_fd, 0, SEEK_END);
+    const size_t capacity =
+        std::max(_options.maxBytes, static_cast<size_t>(existing));
+    if (::ftruncate(_fd, static_cast<off_t>(capacity)) != 0) {
+      ::close(_fd);
+      _fd = -1;
+      return;
+    }
+
+    void *map =
+        ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (map == MAP_FAILED) {
+      ::close(_fd);
+      _fd = -1;
+      return;
+    }
+
+    _map = static_cast<char *>(map);
+    _mapSize = capacity;
+    _offset = static_cast<size_t>(existing);
+    while (_offset > 0 && _map[_offset - 1] == '\0')
+      --_offset;
+    _synced = _offset;
+    _openedAt = std::chrono::steady_clock::now();
+    _lastSync = _openedAt;
+  }
+
+  // Leaves the file holding exactly what was written.
+  inline void close() {
+    if (!_map)
+      return;
+
+    sync();
+    ::munmap(_map, _mapSize);
+    _map = nullptr;
+    [[maybe_unused]] const int truncated =
+        ::ftruncate(_fd, static_cast<off_t>(_offset));
+    ::close(_fd);
+    _fd = -1;
+  }
+
+  inline void sync() {
+    _lastSync = std::chrono::steady_clock::now();
+    if (_offset == _synced)
+      return;
+
+    static const size_t pageSize =
+        static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t start = _synced - _synced % pageSize;
+    ::msync(_map + start, _offset - start, MS_SYNC);
+    _synced = _offset;
+  }
+
+  inline void rotate() {
+    close();
+
+    const std::filesystem::path rotated = segmentPath(_nextSegment++);
+    std::error_code error;
+    std::filesystem::rename(_path, rotated, error);
+    if (!error)
+      schedule(rotated);
+    open();
+  }
+
+  // log.txt becomes log.<index>.txt.
+  inline std::filesystem::path segmentPath(uint32 index) const {
+    std::filesystem::path rotated = _path;
+    rotated.replace_filename(_path.stem().string() + "." +
+                             std::to_string(index) +
+                             _path.extension().string());
+    return rotated;
+  }
+
+  // Index of the segment a file name belongs to, compressed or not, or 0.
+  inline uint32 segmentIndex(const std::filesystem::path &file) const {
+    const string name = file.filename().string();
+    const string prefix = _path.stem().string() + ".";
+    if (!name.starts_with(prefix))
+      return 0;
+
+    uint32 index = 0;
+    size_t pos = prefix.size();
+    for (; pos < name.size() && name[pos] >= '0' && name[pos] <= '9'; ++pos)
+      index = index * 10 + static_cast<uint32>(name[pos] - '0');
+
+    const std::string_view rest = std::string_view(name).substr(pos);
+    return pos > prefix.size() && rest.starts_with(_path.extension().string())
+               ? index
+               : 0;
+  }
+
+  inline uint32 lastSegment() const {
+    uint32 last = 0;
+    std::error_code error;
+    const std::filesystem::path dir =
+        _path.has_parent_path() ? _path.parent_path() : ".";
+    for (const auto &entry : std::filesystem::directory_iterator(dir, error))
+      last = std::max(last, segmentIndex(entry.path()));
+    return last;
+  }
+
+  // Compression and pruning run off the logging path, on a thread started
+  // with the first rotation.
+  inline void schedule(std::filesystem::path rotated) {
+    {
+      std::lock_guard lock(_jobsMutex);
+      _jobs.push_back(std::move(rotated));
+    }
+    if (!_jobThread.joinable())
+      _jobThread = std::thread([this]() { runJobs(); });
+    _jobsReady.notify_one();
+  }
+
+  inline void runJobs() {
+    std::unique_lock lock(_jobsMutex);
+    while (true) {
+      _jobsReady.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+      if (_jobs.empty())
+        return;
+
+      const std::filesystem::path rotated = std::move(_jobs.front());
+      _jobs.pop_front();
+      lock.unlock();
+      if (_options.compress)
+        _options.compress(rotated);
+      prune(segmentIndex(rotated));
+      lock.lock();
+    }
+  }
+
+  inline void prune(uint32 newest) {
+    if (_options.keepSegments == 0 || newest <= _options.keepSegments)
+      return;
+
+    std::error_code error;
+    const std::filesystem::path dir =
+        _path.has_parent_path() ? _path.parent_path() : ".";
+    for (const auto &entry : std::filesystem::directory_iterator(dir, error)) {
+      const uint32 index = segmentIndex(entry.path());
+      if (index > 0 && index <= newest - _options.keepSegments)
+        std::filesystem::remove(entry.path(), error);
+    }
+  }
+
+  std::filesystem::path _path;
+  MappedFileOptions _options;
+  string _line;
+
+  int _fd = -1;
+  char *_map = nullptr;
+  size_t _mapSize = 0;
+  size_t _offset = 0;
+  size_t _synced = 0;
+  std::chrono::steady_clock::time_point _openedAt{};
+  std::chrono::steady_clock::time_point _lastSync{};
+  uint32 _nextSegment = 1;
+
+  std::mutex _jobsMutex;
+  std::condition_variable _jobsReady;
+  std::deque<std::filesystem::path> _jobs;
+  bool _stopping = false;
+  std::thread _jobThread;
+};
+
+#endif // BB_LOG_HAS_MMAP
+
+#ifdef BB_LOG_HAS_SOCKETS
+
+// How long ~NetworkSink() keeps sending what the collector has not taken yet.
+inline constexpr std::chrono::milliseconds LOG_NETWORK_DRAIN_TIMEOUT{1000};
+
+enum class NetworkProtocol {
+  Udp, // Batches packed into datagrams; lost ones stay lost.
+  Tcp, // One persistent stream.
+};
+
+struct NetworkSinkOptions {
+  NetworkProtocol protocol = NetworkProtocol::Udp;
+  // Send the binary log layout (see BinaryFileSink) instead of text.
+  bool binary = false;
+  // UDP: records are packed into datagrams of up to this many bytes. Binary
+  // datagrams each start a session, so every one can be decoded alone.
+  size_t datagramBytes = 8192;
+  // TCP: bytes kept while the collector is connecting or slow to read.
+  // Records that arrive once it is full are dropped and counted.
+  size_t backlogBytes = 4 * 1024 * 1024;
+  // How long a connection attempt may take, and how long to wait before
+  // the next one.
+  std::chrono::milliseconds reconnectInterval{1000};
+  // Where records go while the collector is unreachable; empty picks
+  // ./log.txt, or ./log.bin for binary records.
+  std::filesystem::path fallbackPath;
+};
+
+// Sends records to a remote collector, for targets such as dev kits where
+// local files are slow or awkward to retrieve. The worker's batches go out
+// as a few large datagrams or stream writes, never blocking on the socket.
+// While the collector cannot be reached (a TCP connection fails or drops,
+// a UDP send is refused) records are appended to the fallback file instead,
+// and the sink reconnects every reconnectInterval. A TCP stream's unsent
+// records move to the file on disconnect; binary ones as a session of their
+// own, led by the call sites the stream defined before them. Only a record
+// that partly went out is dropped.
+class NetworkSink : public Sink {
+public:
+  inline NetworkSink(const string &host, uint16 port,
+                     NetworkSinkOptions options = {},
+                     SinkRoute route = SinkRoute::File)
+      : Sink(route), _options(std::move(options)) {
+    // Collectors store text, whichever route the sink takes.
+    SetFormatter(std::make_unique<DefaultFormatter>(LogLayout::Timestamped));
+    if (_options.fallbackPath.empty())
+      _options.fallbackPath = _options.binary ? "./log.bin" : "./log.txt";
+    _options.datagramBytes = std::max<size_t>(_options.datagramBytes, 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype =
+        _options.protocol == NetworkProtocol::Tcp ? SOCK_STREAM : SOCK_DGRAM;
+    addrinfo *found = nullptr;
+    const string service = std::to_string(port);
+    if (::getaddrinfo(host.c_str(), service.c_str(), &hints, &found) == 0 &&
+        found) {
+      std::memcpy(&_address, found->ai_addr, found->ai_addrlen);
+      _addressLength = found->ai_addrlen;
+      ::freeaddrinfo(found);
+      connect();
+    } else {
+      disconnect();
+    }
+  }
+
+  inline ~NetworkSink() override {
+    send(LOG_NETWORK_DRAIN_TIMEOUT);
+    if (_state != State::Disconnected && _sent < _stream.size())
+      disconnect();
+    writeFallback();
+    if (_fd >= 0)
+      ::close(_fd);
+    if (_fallback)
+      std::fclose(_fallback);
+  }
+
+  // Whether records currently go to the collector rather than the file.
+  inline bool IsConnected() const noexcept {
+    return _connected.load(std::memory_order_relaxed);
+  }
+
+  // Records lost to a full backlog, a full socket buffer or an oversized
+  // datagram.
+  inline uint64 Dropped() const noexcept {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+  inline bool NeedsText() const noexcept override { return !_options.binary; }
+
+  inline void Write(const LogRecord &record) override {
+    if (_state == State::Disconnected) {
+      retry();
+      if (_state == State::Disconnected) {
+        encode(record, _fallbackBatch);
+        if (_fallbackBatch.size() >= batchBytes())
+          writeFallback();
+        return;
+      }
+    }
+
+    if (_options.protocol == NetworkProtocol::Udp) {
+      pack(record);
+      return;
+    }
+
+    if (_stream.size() - _sent >= _options.backlogBytes) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    if (_options.binary) {
+      _recordStarts.push_back({_streamBase + _stream.size(),
+                               _streamSites.size()});
+      _encoder.Append(record, _stream, &_streamSites);
+    } else {
+      format(record, _stream);
+    }
+    if (_stream.size() - _sent >= batchBytes())
+      send(std::chrono::milliseconds(0));
+  }
+
+  inline void Flush() override {
+    send(std::chrono::milliseconds(0));
+    writeFallback();
+    retry();
+  }
+
+  inline void Drain(std::chrono::milliseconds timeout) override {
+    send(timeout);
+    writeFallback();
+  }
+
+private:
+  enum class State {
+    Disconnected,
+    Connecting, // TCP only: waiting for the connection to complete.
+    Connected,
+  };
+
+  inline void encode(const LogRecord &record, string &out) {
+    if (_options.binary)
+      _encoder.Append(record, out);
+    else
+      format(record, out);
+  }
+
+  // Appends to the current datagram, sending it first if the record would
+  // not fit.
+  inline void pack(const LogRecord &record) {
+    if (_datagram.empty() && _options.binary)
+      _encoder.Begin(_datagram);
+    const size_t before = _datagram.size();
+    encode(record, _datagram);
+    if (_datagram.size() > _options.datagramBytes && _records > 0) {
+      _datagram.resize(before);
+      sendDatagram();
+      if (_state != State::Connected) {
+        encode(record, _fallbackBatch);
+        return;
+      }
+      if (_options.binary)
+        _encoder.Begin(_datagram);
+      encode(record, _datagram);
+    }
+    ++_records;
+    if (_datagram.size() >= _options.datagramBytes)
+      sendDatagram();
+  }
+
+  inline void sendDatagram() {
+    if (_records == 0)
+      return;
+
+    ssize_t sent;
+    do {
+      sent = ::send(_fd, _datagram.data(), _datagram.size(), MSG_DONTWAIT);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0 && errno == ECONNREFUSED) {
+      // Nobody is listening: keep this datagram, self-contained even when
+      // binary, in the file.
+      _fallbackBatch += _datagram;
+      disconnect();
+    } else if (sent < 0) {
+      _dropped.fetch_add(_records, std::memory_order_relaxed);
+    }
+    _datagram.clear();
+    _records = 0;
+  }
+
+  // Sends what the socket takes within `timeout`.
+  inline void send(std::chrono::milliseconds timeout) {
+    if (_options.protocol == NetworkProtocol::Udp) {
+      if (_state == State::Connected)
+        sendDatagram();
+      return;
+    }
+    if (_state == State::Disconnected)
+      return;
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (_state == State::Connecting || _sent < _stream.size()) {
+      const auto now = std::chrono::steady_clock::now();
+      if (_state == State::Connecting &&
+          now - _attemptedAt >= _options.reconnectInterval) {
+        disconnect();
+        return;
+      }
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - now);
+      if (_state == State::Connecting)
+        left = std::min(left, std::chrono::duration_cast<
+                                  std::chrono::milliseconds>(
+                                  _attemptedAt + _options.reconnectInterval -
+                                  now));
+      pollfd out{.fd = _fd, .events = POLLOUT, .revents = 0};
+      const int ready =
+          ::poll(&out, 1, static_cast<int>(std::max<int64>(left.count(), 0)));
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready <= 0) {
+        if (std::chrono::steady_clock::now() < deadline)
+          continue;
+        break;
+      }
+
+      if (_state == State::Connecting) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (::getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 ||
+            error != 0) {
+          disconnect();
+          return;
+        }
+        _state = State::Connected;
+        _connected.store(true, std::memory_order_relaxed);
+        continue;
+      }
+
+      const ssize_t written = ::send(_fd, _stream.data() + _sent,
+                                     _stream.size() - _sent,
+                                     detail::SOCKET_SEND_FLAGS);
+      if (written < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+          continue;
+        disconnect();
+        return;
+      }
+      _sent += static_cast<size_t>(written);
+    }
+
+    while (!_recordStarts.empty() &&
+           _recordStarts.front().offset < _streamBase + _sent)
+      _recordStarts.pop_front();
+    if (_sent == _stream.size() || _sent >= _stream.size() / 2) {
+      _stream.erase(0, _sent);
+      _streamBase += _sent;
+      _sent = 0;
+    }
+  }
+
+  // Opens a non-blocking socket towards the collector. UDP is connected too,
+  // so that refused datagrams are reported.
+  inline void connect() {
+    _attemptedAt = std::chrono::steady_clock::now();
+    const bool tcp = _options.protocol == NetworkProtocol::Tcp;
+    _fd = ::socket(_address.ss_family, tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (_fd < 0) {
+      disconnect();
+      return;
+    }
+    ::fcntl(_fd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    const int on = 1;
+    ::setsockopt(_fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    int result;
+    do {
+      result = ::connect(_fd, reinterpret_cast<const sockaddr *>(&_address),
+                         _addressLength);
+    } while (result != 0 && errno == EINTR);
+    if (result != 0 && errno != EINPROGRESS) {
+      disconnect();
+      return;
+    }
+
+    clearStream();
+    if (tcp && _options.binary)
+      _encoder.Begin(_stream);
+    _state = result == 0 ? State::Connected : State::Connecting;
+    _connected.store(_state == State::Connected, std::memory_order_relaxed);
+  }
+
+  // Switches to the fallback file until the next attempt.
+  inline void disconnect() {
+    if (_fd >= 0) {
+      ::close(_fd);
+      _fd = -1;
+    }
+    _state = State::Disconnected;
+    _connected.store(false, std::memory_order_relaxed);
+    _attemptedAt = std::chrono::steady_clock::now();
+
+    if (!_options.binary && _sent < _stream.size()) {
+      // Skip the rest of a line that partly went out.
+      size_t from = _sent;
+      if (from > 0 && _stream[from - 1] != '\n') {
+        const size_t lineEnd = _stream.find('\n', from);
+        from = lineEnd == string::npos ? _stream.size() : lineEnd + 1;
+      }
+      _fallbackBatch.append(_stream, from);
+    } else if (!_recordStarts.empty()) {
+      // Records not yet sent, less one that partly went out, as a session
+      // of their own: the call sites defined before them, then the records,
+      // which carry the sites they define themselves.
+      const auto first = std::lower_bound(
+          _recordStarts.begin(), _recordStarts.end(), _streamBase + _sent,
+          [](const RecordStart &start, uint64 offset) {
+            return start.offset < offset;
+          });
+      if (first != _recordStarts.end()) {
+        _encoder.Begin(_fallbackBatch);
+        _fallbackBatch.append(_streamSites, 0, first->sites);
+        _fallbackBatch.append(_stream,
+                              static_cast<size_t>(first->offset - _streamBase));
+      }
+    }
+    clearStream();
+    if (_options.binary)
+      _encoder.Begin(_fallbackBatch);
+  }
+
+  inline void clearStream() {
+    _stream.clear();
+    _sent = 0;
+    _streamBase = 0;
+    _streamSites.clear();
+    _recordStarts.clear();
+  }
+
+  inline void retry() {
+    if (_state != State::Disconnected || _addressLength == 0 ||
+        std::chrono::steady_clock::now() - _attemptedAt <
+            _options.reconnectInterval)
+      return;
+
+    writeFallback();
+    connect();
+  }
+
+  inline void writeFallback() {
+    if (_fallbackBatch.empty())
+      return;
+
+    if (!_fallback) {
+      _fallback = std::fopen(_options.fallbackPath.string().c_str(), "ab");
+      if (_fallback)
+        std::setvbuf(_fallback, nullptr, _IONBF, 0);
+    }
+    if (_fallback)
+      std::fwrite(_fallbackBatch.data(), 1, _fallbackBatch.size(), _fallback);
+    _fallbackBatch.clear();
+  }
+
+  NetworkSinkOptions _options;
+  sockaddr_storage _address{};
+  socklen_t _addressLength = 0;
+  int _fd = -1;
+  State _state = State::Disconnected;
+  std::atomic<bool> _connected = false;
+  std::chrono::steady_clock::time_point _attemptedAt;
+  detail::BinaryLogEncoder _encoder;
+  string _datagram; // UDP: the datagram being filled.
+  uint32 _records = 0; // Records in _datagram.
+  string _stream; // TCP: bytes queued for the stream.
+  size_t _sent = 0; // Leading bytes of _stream already sent.
+  uint64 _streamBase = 0; // Stream bytes sent and erased from _stream.
+  // Binary TCP: the session's call site records, and where each record not
+  // yet sent starts in the stream, so a disconnect can keep them.
+  struct RecordStart {
+    uint64 offset;
+    size_t sites; // Size of _streamSites before the record.
+  };
+  string _streamSites;
+  std::deque<RecordStart> _recordStarts;
+  string _fallbackBatch;
+  std::FILE *_fallback = nullptr;
+  std::atomic<uint64> _dropped = 0;
+};
+
+#endif // BB_LOG_HAS_SOCKETS
+
+} // namespace bb::core
+
+#endif // _GENERIC_LOG_SINKS_HPP
@@ -2,348 +2,4656 @@
 #define _GENERIC_LOGGER_HPP
 
 #include "Defines.hpp"
+#include "Memory.hpp"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
 #include <chrono>
+#include <climits>
+#include <concepts>
 #include <condition_variable>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <format>
-#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <mutex>
-#include <print>
-#include <queue>
+#include <new>
+#include <optional>
 #include <source_location>
 #include <string_view>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <ctime>
+
+// Ticks come from the TSC on x86 unless BB_LOG_NO_TSC is defined, in which
+// case (and on every other target) steady_clock is used instead.
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+     defined(_M_IX86)) &&                                                      \
+    !defined(BB_LOG_NO_TSC)
+#define BB_LOG_HAS_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BB_LOG_HAS_POSIX 1
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+// Numeric values of LogLevel, usable in preprocessor conditions.
+#define BB_LOG_LEVEL_TRACE 0
+#define BB_LOG_LEVEL_DEBUG 1
+#define BB_LOG_LEVEL_INFO 2
+#define BB_LOG_LEVEL_WARN 3
+#define BB_LOG_LEVEL_ERROR 4
+#define BB_LOG_LEVEL_FATAL 5
+#define BB_LOG_LEVEL_OFF 6
+
+// Log statements below this level are compiled out entirely. Defaults keep
+// the historical behaviour: everything in debug builds, ERROR and FATAL only
+// when NDEBUG is defined.
+#ifndef BB_LOG_ACTIVE_LEVEL
+#ifdef NDEBUG
+#define BB_LOG_ACTIVE_LEVEL BB_LOG_LEVEL_ERROR
+#else
+#define BB_LOG_ACTIVE_LEVEL BB_LOG_LEVEL_TRACE
+#endif
+#endif
 
 namespace bb::core {
 
-inline constexpr std::string_view COLOR_GREY = "\x1b[90m";
-inline constexpr std::string_view COLOR_BLUE = "\x1b[34m";
-inline constexpr std::string_view COLOR_GREEN = "\x1b[32m";
-inline constexpr std::string_view COLOR_YELLOW = "\x1b[33m";
-inline constexpr std::string_view COLOR_RED = "\x1b[31m";
-inline constexpr std::string_view COLOR_FATAL = "\x1b[41;97m";
-inline constexpr std::string_view COLOR_RESET = "\x1b[0m";
+inline constexpr std::string_view COLOR_GREY = "\x1b[90m";
+inline constexpr std::string_view COLOR_BLUE = "\x1b[34m";
+inline constexpr std::string_view COLOR_GREEN = "\x1b[32m";
+inline constexpr std::string_view COLOR_YELLOW = "\x1b[33m";
+inline constexpr std::string_view COLOR_RED = "\x1b[31m";
+inline constexpr std::string_view COLOR_FATAL = "\x1b[41;97m";
+inline constexpr std::string_view COLOR_RESET = "\x1b[0m";
+
+using AtomicBool = std::atomic<bool>;
+
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Number of slots in the bounded queue between producers and the worker.
+inline constexpr size_t LOG_QUEUE_CAPACITY = 4096;
+
+// Number of slots in each producer's own ring when per-thread buffers are on.
+inline constexpr size_t LOG_THREAD_BUFFER_CAPACITY = 1024;
+
+// Messages the worker drains between two samples of the queue depth.
+inline constexpr uint32 LOG_QUEUE_DEPTH_SAMPLE_INTERVAL = 256;
+
+// Default size at which sinks flush their batched output.
+inline constexpr size_t LOG_BATCH_BYTES = 64 * 1024;
+
+// Number of records queued to a sink that runs on its own thread.
+inline constexpr size_t LOG_SINK_QUEUE_CAPACITY = 4096;
+
+// Minimum time between two "messages dropped" summaries.
+inline constexpr std::chrono::seconds LOG_DROP_REPORT_INTERVAL{1};
+
+// Buckets of the delivery latency and zone duration histograms; bucket i
+// counts durations in [2^i, 2^(i+1)) nanoseconds.
+inline constexpr size_t LOG_LATENCY_BUCKETS = 40;
+
+// Formatted console output kept while stdout is not accepting writes, and
+// how long a destroyed ConsoleSink waits for it to drain.
+inline constexpr size_t LOG_CONSOLE_BACKLOG_BYTES = 1024 * 1024;
+inline constexpr std::chrono::milliseconds LOG_CONSOLE_DRAIN_TIMEOUT{1000};
+
+// How long Logger::Flush() waits by default, and how long the exit handler
+// gives the worker to get everything out.
+inline constexpr std::chrono::milliseconds LOG_FLUSH_TIMEOUT{1000};
+inline constexpr std::chrono::milliseconds LOG_SHUTDOWN_TIMEOUT{2000};
+
+// Trace-event bytes the profiler buffers before writing them out.
+inline constexpr size_t LOG_TRACE_BATCH_SIZE = 64 * 1024;
+
+// What a producer does when the queue it logs into is full.
+enum class OverflowPolicy {
+  Block,      // Wait for the worker to make room.
+  DropNewest, // Discard the message being logged.
+  DropOldest, // Evict the oldest queued record to make room.
+  Sample,     // Past three quarters full keep one message in N, then drop.
+};
+
+enum class TimestampPrecision {
+  Seconds,
+  Milliseconds,
+  Microseconds,
+  Nanoseconds,
+};
+
+enum class LogLevel {
+  Trace = BB_LOG_LEVEL_TRACE,
+  Debug = BB_LOG_LEVEL_DEBUG,
+  Info = BB_LOG_LEVEL_INFO,
+  Warn = BB_LOG_LEVEL_WARN,
+  Error = BB_LOG_LEVEL_ERROR,
+  Fatal = BB_LOG_LEVEL_FATAL,
+  Off = BB_LOG_LEVEL_OFF,
+};
+
+// Size of the buffer a LogValue writes one value into; the rest is cut off.
+inline constexpr size_t LOG_VALUE_BUFFER_SIZE = 128;
+
+// Where LogValue<T>::Write() puts its text: a small buffer on the stack,
+// copied into the message once, so custom types never build temporaries.
+class LogWriter {
+public:
+  inline void Append(std::string_view text) noexcept {
+    const size_t size = std::min(text.size(), _buffer.size() - _size);
+    std::memcpy(_buffer.data() + _size, text.data(), size);
+    _size += size;
+  }
+
+  inline void Put(char c) noexcept {
+    if (_size < _buffer.size())
+      _buffer[_size++] = c;
+  }
+
+  // Integers and floats through std::to_chars, floats in their shortest
+  // round-trip form like "{}".
+  template <typename T>
+    requires std::is_arithmetic_v<T> && (!std::is_same_v<T, bool>)
+  inline void Number(T value) noexcept {
+    char *const end = _buffer.data() + _buffer.size();
+    const auto [ptr, error] = std::to_chars(_buffer.data() + _size, end, value);
+    if (error == std::errc())
+      _size = static_cast<size_t>(ptr - _buffer.data());
+  }
+
+  inline std::string_view View() const noexcept {
+    return {_buffer.data(), _size};
+  }
+
+private:
+  std::array<char, LOG_VALUE_BUFFER_SIZE> _buffer;
+  size_t _size = 0;
+};
+
+// Opt-in fast path for types logged all the time, such as vectors, entity
+// handles and enum states. A specialisation provides
+//   using Captured = ...;  // trivially copyable
+//   static Captured Capture(const T &value) noexcept;
+//   static void Write(LogWriter &out, const Captured &value) noexcept;
+// Deferred formatting then stores Capture()'s result raw, and the worker
+// renders it with Write() straight into the message. Such types also get a
+// std::formatter, which accepts no format spec.
+template <typename T> struct LogValue {};
+
+namespace detail {
+
+template <typename T>
+concept HasLogValue =
+    requires(const T &value, LogWriter &out) {
+      typename LogValue<T>::Captured;
+      {
+        LogValue<T>::Capture(value)
+      } -> std::convertible_to<typename LogValue<T>::Captured>;
+      LogValue<T>::Write(out, LogValue<T>::Capture(value));
+    } && std::is_trivially_copyable_v<typename LogValue<T>::Captured>;
+
+template <typename T>
+inline constexpr bool IS_LOG_VALUE = HasLogValue<std::remove_cv_t<T>>;
+
+// Indexed by level; Off has no name.
+inline constexpr std::array<std::string_view, 7> LEVEL_NAMES{
+    "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL", ""};
+
+} // namespace detail
+
+inline constexpr const char *ToString(LogLevel lvl) {
+  const auto index = static_cast<size_t>(lvl);
+  return index < detail::LEVEL_NAMES.size() ? detail::LEVEL_NAMES[index].data()
+                                            : "UNKNOWN";
+}
+
+template <> struct LogValue<LogLevel> {
+  using Captured = LogLevel;
+
+  static inline Captured Capture(LogLevel lvl) noexcept { return lvl; }
+
+  static inline void Write(LogWriter &out, LogLevel lvl) noexcept {
+    const auto index = static_cast<size_t>(lvl);
+    out.Append(index < detail::LEVEL_NAMES.size() ? detail::LEVEL_NAMES[index]
+                                                  : "UNKNOWN");
+  }
+};
+
+inline constexpr const char *LevelColour(LogLevel lvl) {
+  switch (lvl) {
+  case LogLevel::Trace:
+    return COLOR_GREY.data();
+  case LogLevel::Debug:
+    return COLOR_BLUE.data();
+  case LogLevel::Info:
+    return COLOR_GREEN.data();
+  case LogLevel::Warn:
+    return COLOR_YELLOW.data();
+  case LogLevel::Error:
+    return COLOR_RED.data();
+  case LogLevel::Fatal:
+    return COLOR_FATAL.data(); // red bg, white text
+  default:
+    return COLOR_RESET.data();
+  }
+}
+
+// Case-insensitive; accepts what ToString() returns, plus "warning" and
+// "off".
+inline constexpr std::optional<LogLevel> ParseLogLevel(std::string_view text) {
+  const auto equals = [text](std::string_view name) {
+    if (text.size() != name.size())
+      return false;
+    for (size_t i = 0; i < name.size(); ++i) {
+      const char c = text[i];
+      if ((c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != name[i])
+        return false;
+    }
+    return true;
+  };
+  if (equals("trace"))
+    return LogLevel::Trace;
+  if (equals("debug"))
+    return LogLevel::Debug;
+  if (equals("info"))
+    return LogLevel::Info;
+  if (equals("warn") || equals("warning"))
+    return LogLevel::Warn;
+  if (equals("error"))
+    return LogLevel::Error;
+  if (equals("fatal"))
+    return LogLevel::Fatal;
+  if (equals("off"))
+    return LogLevel::Off;
+  return std::nullopt;
+}
+
+// A subsystem's channel, declared at namespace scope with BB_LOG_CATEGORY
+// and logged to with LOG_INFO_C(Net, ...). Its level stands in for the
+// Logger's console and file thresholds on its sites, so one channel can go
+// to Trace without flooding the rest, and a disabled channel costs one load
+// and compare before any argument is evaluated. Levels are shared by every
+// Logger; categorised sites that are filtered out skip the flight recorder.
+class LogCategory {
+public:
+  inline LogCategory(std::string_view name, LogLevel level)
+      : _name(name), _level(level) {
+    Registry &categories = registry();
+    std::lock_guard lock(categories.mutex);
+    categories.all.push_back(this);
+  }
+
+  inline ~LogCategory() {
+    Registry &categories = registry();
+    std::lock_guard lock(categories.mutex);
+    std::erase(categories.all, this);
+  }
+
+  LogCategory(const LogCategory &) = delete;
+  LogCategory &operator=(const LogCategory &) = delete;
+
+  inline bool Enabled(LogLevel lvl) const noexcept {
+    return lvl >= _level.load(std::memory_order_relaxed);
+  }
+
+  inline LogLevel Level() const noexcept {
+    return _level.load(std::memory_order_relaxed);
+  }
+
+  inline void SetLevel(LogLevel lvl) noexcept {
+    _level.store(lvl, std::memory_order_relaxed);
+  }
+
+  inline std::string_view Name() const noexcept { return _name; }
+
+  // Case-insensitive lookup, or null.
+  static inline LogCategory *Find(std::string_view name) {
+    Registry &categories = registry();
+    std::lock_guard lock(categories.mutex);
+    for (LogCategory *category : categories.all) {
+      if (sameName(category->_name, name))
+        return category;
+    }
+    return nullptr;
+  }
+
+  // Every declared category, e.g. to list them from a console command.
+  static inline std::vector<LogCategory *> All() {
+    Registry &categories = registry();
+    std::lock_guard lock(categories.mutex);
+    return categories.all;
+  }
+
+  // Applies a spec such as "net=trace, render=warn" from a console command
+  // or config line; "*" sets every category. Entries are separated by
+  // commas or whitespace. Returns false if an entry names an unknown
+  // category or level or is malformed; the valid ones still apply.
+  static inline bool Configure(std::string_view spec) {
+    bool ok = true;
+    while (!spec.empty()) {
+      const size_t end = spec.find_first_of(", \t\r\n");
+      const std::string_view entry = spec.substr(0, end);
+      spec = end == std::string_view::npos ? std::string_view()
+                                           : spec.substr(end + 1);
+      if (entry.empty())
+        continue;
+
+      const size_t equals = entry.find('=');
+      const std::optional<LogLevel> level =
+          equals == std::string_view::npos
+              ? std::nullopt
+              : ParseLogLevel(entry.substr(equals + 1));
+      if (!level) {
+        ok = false;
+        continue;
+      }
+      const std::string_view name = entry.substr(0, equals);
+      if (name == "*") {
+        for (LogCategory *category : All())
+          category->SetLevel(*level);
+      } else if (LogCategory *category = Find(name)) {
+        category->SetLevel(*level);
+      } else {
+        ok = false;
+      }
+    }
+    return ok;
+  }
+
+  // Configure() over a whole file, one or more entries per line; '#' starts
+  // a comment. False if the file cannot be read or an entry is invalid.
+  static inline bool ConfigureFromFile(const std::filesystem::path &path) {
+    std::FILE *file = std::fopen(path.string().c_str(), "rb");
+    if (!file)
+      return false;
+
+    bool ok = true;
+    char line[1024];
+    while (std::fgets(line, sizeof(line), file)) {
+      std::string_view text(line);
+      text = text.substr(0, text.find('#'));
+      ok &= Configure(text);
+    }
+    std::fclose(file);
+    return ok;
+  }
+
+private:
+  struct Registry {
+    std::mutex mutex;
+    std::vector<LogCategory *> all;
+  };
+
+  // Leaked: categories in other translation units may still unregister
+  // during static destruction.
+  static inline Registry &registry() {
+    static Registry *categories = new Registry();
+    return *categories;
+  }
+
+  static inline bool sameName(std::string_view a, std::string_view b) {
+    return std::ranges::equal(a, b, [](char x, char y) {
+      const auto lower = [](char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+      };
+      return lower(x) == lower(y);
+    });
+  }
+
+  std::string_view _name;
+  std::atomic<LogLevel> _level;
+};
+
+namespace detail {
+
+// Keeps the path from "src/" on, or falls back to the basename.
+inline constexpr const char *trimPath(const char *path) {
+  const char *basename = path;
+  for (const char *p = path; *p; ++p) {
+    if (p[0] == 's' && p[1] == 'r' && p[2] == 'c' && p[3] == '/')
+      return p;
+    if (*p == '/')
+      basename = p + 1;
+  }
+  return basename;
+}
+
+} // namespace detail
+
+// Segments a call site's format string is split into at compile time;
+// formats with more fall back to std::vformat.
+inline constexpr size_t LOG_FORMAT_SEGMENTS = 16;
+
+namespace detail {
+
+// A run of literal text, or a replacement field and the argument it takes.
+// Fields with a format spec keep their text, "{:.3f}", to format that one
+// argument with.
+struct FormatSegment {
+  uint16 begin = 0;
+  uint16 size = 0;
+  int16 arg = -1; // -1 for literal text.
+  bool spec = false;
+};
+
+struct FormatPlan {
+  std::array<FormatSegment, LOG_FORMAT_SEGMENTS> segments{};
+  uint8 count = 0;
+  bool usable = false; // False when the format needs std::vformat.
+};
+
+// Splits `fmt`, already checked against its arguments by fstring, so that
+// formatting a message only walks the segments. Escaped braces end a
+// literal segment on their first character. Nested replacement fields and
+// specs on explicitly numbered fields are left to std::vformat.
+inline constexpr FormatPlan planFormat(std::string_view fmt) {
+  FormatPlan plan;
+  if (fmt.size() > UINT16_MAX)
+    return plan;
+
+  const auto push = [&plan](size_t begin, size_t size, int arg, bool spec) {
+    if (size == 0 && arg < 0)
+      return true;
+    if (plan.count == LOG_FORMAT_SEGMENTS)
+      return false;
+    plan.segments[plan.count++] = {static_cast<uint16>(begin),
+                                   static_cast<uint16>(size),
+                                   static_cast<int16>(arg), spec};
+    return true;
+  };
+
+  size_t literal = 0;
+  int nextArg = 0;
+  for (size_t pos = 0; pos < fmt.size();) {
+    const char c = fmt[pos];
+    if (c != '{' && c != '}') {
+      ++pos;
+      continue;
+    }
+    if (c == '}' || (pos + 1 < fmt.size() && fmt[pos + 1] == '{')) {
+      if (!push(literal, pos + 1 - literal, -1, false))
+        return plan;
+      pos += 2;
+      literal = pos;
+      continue;
+    }
+
+    if (!push(literal, pos - literal, -1, false))
+      return plan;
+    // Plain loops: GCC 12 cannot run string_view::find on these in a
+    // constant expression.
+    size_t close = pos + 1;
+    size_t colon = 0;
+    for (; close < fmt.size() && fmt[close] != '}'; ++close) {
+      if (fmt[close] == '{')
+        return plan;
+      if (fmt[close] == ':' && colon == 0)
+        colon = close;
+    }
+    if (close == fmt.size())
+      return plan;
+
+    const size_t idEnd = colon != 0 ? colon : close;
+    int arg = 0;
+    if (idEnd == pos + 1) {
+      arg = nextArg++;
+    } else {
+      if (colon != 0)
+        return plan;
+      for (size_t i = pos + 1; i < idEnd; ++i) {
+        if (fmt[i] < '0' || fmt[i] > '9' || arg > INT16_MAX)
+          return plan;
+        arg = arg * 10 + (fmt[i] - '0');
+      }
+    }
+    if (arg > INT16_MAX)
+      return plan;
+
+    const bool spec = colon != 0;
+    if (!push(pos, close + 1 - pos, arg, spec))
+      return plan;
+    pos = close + 1;
+    literal = pos;
+  }
+  if (!push(literal, fmt.size() - literal, -1, false))
+    return plan;
+
+  plan.usable = true;
+  return plan;
+}
+
+} // namespace detail
+
+// The message and field names of a structured call site (see LOG_*_KV);
+// its arguments are the field values, in order.
+struct LogFields {
+  std::string_view message;
+  const std::string_view *keys;
+  uint32 count;
+};
+
+// Everything about a log statement that is known at compile time. The LOG_*
+// macros give each call site a static constexpr LogSite, and messages only
+// carry a pointer to it.
+struct LogSite {
+  inline constexpr LogSite(LogLevel lvl, std::string_view format,
+                           std::source_location where,
+                           const LogFields *structured = nullptr,
+                           const LogCategory *channel = nullptr)
+      : level(lvl), fmt(format), file(detail::trimPath(where.file_name())),
+        function(where.function_name()), line(where.line()),
+        levelName(ToString(lvl)), colour(LevelColour(lvl)),
+        fields(structured), category(channel),
+        plan(detail::planFormat(format)) {}
+
+  LogLevel level;
+  std::string_view fmt;
+  const char *file;
+  const char *function;
+  uint32 line;
+  const char *levelName;
+  const char *colour;
+  const LogFields *fields; // Null for plain format-string sites.
+  const LogCategory *category; // Null outside LOG_*_C.
+  detail::FormatPlan plan;
+};
+
+namespace detail {
+
+inline constexpr size_t escapedFormatSize(std::string_view text) {
+  size_t size = text.size();
+  for (const char c : text)
+    size += c == '{' || c == '}';
+  return size;
+}
+
+// Size of the format a structured site renders as text: the message, then
+// " key={}" per field.
+template <size_t Count>
+inline constexpr size_t
+fieldFormatSize(std::string_view message,
+                const std::array<std::string_view, Count> &keys) {
+  size_t size = escapedFormatSize(message);
+  for (const std::string_view key : keys)
+    size += escapedFormatSize(key) + 4;
+  return size;
+}
+
+template <size_t Size> struct FieldFormat {
+  std::array<char, Size> chars{};
+
+  inline constexpr std::string_view View() const {
+    return {chars.data(), Size};
+  }
+};
+
+template <size_t Size, size_t Count>
+inline constexpr FieldFormat<Size>
+fieldFormat(std::string_view message,
+            const std::array<std::string_view, Count> &keys) {
+  FieldFormat<Size> format;
+  size_t pos = 0;
+  const auto append = [&](std::string_view text, bool escape) {
+    for (const char c : text) {
+      if (escape && (c == '{' || c == '}'))
+        format.chars[pos++] = c;
+      format.chars[pos++] = c;
+    }
+  };
+  append(message, true);
+  for (const std::string_view key : keys) {
+    append(" ", false);
+    append(key, true);
+    append("={}", false);
+  }
+  return format;
+}
+
+} // namespace detail
+
+// How many calls a rate-limited call site skipped before this one got
+// through; sinks append it to the message.
+struct LogSuppressed {
+  uint32 count = 0;
+};
+
+// Per-call-site state behind the *_EVERY_N, *_EVERY_MS and *_ONCE macros.
+// It is checked after the level but before the arguments are evaluated, so
+// a rejected call costs a relaxed atomic or two and no formatting.
+class LogThrottle {
+public:
+  constexpr LogThrottle() = default;
+
+  // Lets the first call through and then every `n`th one.
+  inline bool EveryN(uint32 n, LogSuppressed &suppressed) noexcept {
+    const uint64 count = _count.fetch_add(1, std::memory_order_relaxed);
+    if (n <= 1)
+      return true;
+    if (count % n != 0)
+      return false;
+    suppressed.count = count == 0 ? 0 : n - 1;
+    return true;
+  }
+
+  // Lets at most one call through per `intervalMs` milliseconds.
+  inline bool EveryMs(int64 intervalMs, LogSuppressed &suppressed) noexcept {
+    const int64 now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count();
+    int64 last = _lastMs.load(std::memory_order_relaxed);
+    if ((last != NEVER && now - last < intervalMs) ||
+        !_lastMs.compare_exchange_strong(last, now,
+                                         std::memory_order_relaxed)) {
+      _suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    suppressed.count = _suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Lets the first `n` calls through, then stays closed with a plain load.
+  inline bool First(uint32 n, LogSuppressed &) noexcept {
+    return _count.load(std::memory_order_relaxed) < n &&
+           _count.fetch_add(1, std::memory_order_relaxed) < n;
+  }
+
+private:
+  static constexpr int64 NEVER = std::numeric_limits<int64>::min();
+
+  std::atomic<uint64> _count = 0;
+  std::atomic<int64> _lastMs = NEVER;
+  std::atomic<uint32> _suppressed = 0;
+};
+
+// Size of the inline buffer deferred messages capture their arguments into.
+inline constexpr size_t LOG_ARG_BUFFER_SIZE = 256;
+
+// Messages the flight recorder keeps; a power of two.
+inline constexpr size_t LOG_FLIGHT_RECORDER_CAPACITY = 1024;
+
+// Alternate signal stack the crash handlers dump on, per thread.
+inline constexpr size_t LOG_CRASH_STACK_SIZE = 64 * 1024;
+
+using LogClock = std::chrono::system_clock;
+using DeferredFormatFn = void (*)(const LogSite &site, const std::byte *args,
+                                  string &out);
+
+// How a captured argument is laid out, so that tools outside the process can
+// decode it. Opaque values are raw bytes only the formatter in-process knows.
+enum class LogArgType : uint8 {
+  Bool,
+  Char,
+  Int8,
+  Int16,
+  Int32,
+  Int64,
+  UInt8,
+  UInt16,
+  UInt32,
+  UInt64,
+  Float32,
+  Float64,
+  String,
+  Opaque,
+};
+
+// Describes the argument list of one log statement; one per set of Args.
+struct LogArgCodec {
+  DeferredFormatFn format; // Null when the arguments cannot be captured.
+  const LogArgType *types;
+  uint32 count;
+  bool portable; // No Opaque arguments.
+};
+
+// Footprint of a queued message, ring sequence number included.
+inline constexpr size_t LOG_MESSAGE_SLOT_SIZE = 4 * CACHE_LINE_SIZE;
+
+// Payload bytes a message carries inline; the header takes up the rest of
+// its slot.
+inline constexpr size_t LOG_INLINE_PAYLOAD_SIZE = 200;
+
+// Size of the pooled blocks longer payloads are chained into.
+inline constexpr size_t LOG_PAYLOAD_CHUNK_SIZE = 1024;
+
+namespace detail {
+struct PayloadChunk;
+} // namespace detail
+
+// What a queued message carries.
+enum class LogMessageKind : uint8 {
+  Record, // A log statement, for the sinks.
+  Zone,   // A PROFILE_SCOPE zone, for the profiler only.
+  Flush,  // A Logger::Flush() marker.
+};
+
+// A fixed-size record, written in place into its queue slot. The payload is
+// the formatted text or, with deferred formatting, the raw arguments. What
+// does not fit inline is chained into chunks from a pool, so messages never
+// touch the heap once the pool has warmed up.
+struct LogMessage {
+  const LogSite *site = nullptr;
+  const LogArgCodec *codec = nullptr;
+  uint64 stamp = 0; // Raw tick taken at the call site, see detail::tick().
+  detail::PayloadChunk *overflow = nullptr;
+  uint32 size = 0; // Payload bytes, inline and chained.
+  uint32 suppressed = 0; // Calls a rate-limited site let pass since its last.
+  bool toFile = false;
+  bool toConsole = false;
+  bool captured = false; // Payload holds raw arguments rather than text.
+  LogMessageKind kind = LogMessageKind::Record;
+  std::array<std::byte, LOG_INLINE_PAYLOAD_SIZE> payload;
+};
+
+namespace detail {
+
+// Cheapest monotonic tick available: the TSC on x86, steady_clock elsewhere.
+// Ticks order messages across threads and become wall-clock time only on the
+// worker, through TickClock.
+inline uint64 tick() noexcept {
+#ifdef BB_LOG_HAS_TSC
+  return __rdtsc();
+#else
+  return static_cast<uint64>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+struct PayloadChunk {
+  PayloadChunk *next;
+  std::byte data[LOG_PAYLOAD_CHUNK_SIZE - sizeof(PayloadChunk *)];
+};
+
+// Payload chunks shared by every producer. A message only needs them when
+// its payload outgrows the inline bytes, so a mutex is cheap enough.
+class PayloadPool {
+public:
+  // Leaked like Logger::Self(), for messages logged during static
+  // destruction.
+  static inline PayloadPool &Self() {
+    static PayloadPool *pool = new PayloadPool();
+    return *pool;
+  }
+
+  inline PayloadChunk *Acquire() {
+    std::lock_guard lock(_mutex);
+    auto *chunk = ::new (_chunks.Acquire()) PayloadChunk;
+    chunk->next = nullptr;
+    return chunk;
+  }
+
+  // Takes back a whole chain.
+  inline void Release(PayloadChunk *chain) {
+    std::lock_guard lock(_mutex);
+    while (chain) {
+      PayloadChunk *next = chain->next;
+      _chunks.Release(chain);
+      chain = next;
+    }
+  }
+
+private:
+  std::mutex _mutex;
+  FixedBlockPool _chunks{sizeof(PayloadChunk), 16};
+};
+
+// Appends to a message's payload, spilling into pooled chunks.
+class PayloadWriter {
+public:
+  inline explicit PayloadWriter(LogMessage &msg) noexcept
+      : _msg(msg), _pos(msg.payload.data()),
+        _end(msg.payload.data() + msg.payload.size()) {
+    _msg.overflow = nullptr;
+    _msg.size = 0;
+  }
+
+  inline void Write(const void *data, size_t size) {
+    const auto *bytes = static_cast<const std::byte *>(data);
+    _msg.size += static_cast<uint32>(size);
+    while (size > 0) {
+      if (_pos == _end)
+        grow();
+      const size_t chunk = std::min(size, static_cast<size_t>(_end - _pos));
+      std::memcpy(_pos, bytes, chunk);
+      _pos += chunk;
+      bytes += chunk;
+      size -= chunk;
+    }
+  }
+
+  inline void Put(char c) {
+    if (_pos == _end)
+      grow();
+    *_pos++ = static_cast<std::byte>(c);
+    ++_msg.size;
+  }
+
+private:
+  inline void grow() {
+    PayloadChunk *chunk = PayloadPool::Self().Acquire();
+    if (_tail)
+      _tail->next = chunk;
+    else
+      _msg.overflow = chunk;
+    _tail = chunk;
+    _pos = chunk->data;
+    _end = chunk->data + sizeof(chunk->data);
+  }
+
+  LogMessage &_msg;
+  std::byte *_pos;
+  std::byte *_end;
+  PayloadChunk *_tail = nullptr;
+};
+
+// Output iterator formatting straight into a payload.
+struct PayloadOutput {
+  using difference_type = std::ptrdiff_t;
+
+  PayloadWriter *writer;
+
+  inline PayloadOutput &operator=(char c) {
+    writer->Put(c);
+    return *this;
+  }
+  inline PayloadOutput &operator*() noexcept { return *this; }
+  inline PayloadOutput &operator++() noexcept { return *this; }
+  inline PayloadOutput &operator++(int) noexcept { return *this; }
+};
+
+// The payload as one contiguous view, copied into `scratch` only when it
+// was chained.
+inline std::string_view payloadView(const LogMessage &msg, string &scratch) {
+  const auto *inlined = reinterpret_cast<const char *>(msg.payload.data());
+  if (!msg.overflow)
+    return {inlined, msg.size};
+
+  scratch.assign(inlined, msg.payload.size());
+  size_t remaining = msg.size - msg.payload.size();
+  for (const PayloadChunk *chunk = msg.overflow; chunk && remaining > 0;
+       chunk = chunk->next) {
+    const size_t size = std::min(remaining, sizeof(chunk->data));
+    scratch.append(reinterpret_cast<const char *>(chunk->data), size);
+    remaining -= size;
+  }
+  return scratch;
+}
+
+inline void releasePayload(LogMessage &msg) {
+  PayloadPool::Self().Release(msg.overflow);
+  msg.overflow = nullptr;
+}
+
+// Flat buffer counterpart of PayloadWriter, for callers that checked the
+// size up front.
+struct SpanWriter {
+  std::byte *pos;
+
+  inline void Write(const void *data, size_t size) noexcept {
+    std::memcpy(pos, data, size);
+    pos += size;
+  }
+};
+
+template <typename T>
+inline constexpr bool IS_STRING_ARG =
+    std::is_same_v<T, string> || std::is_same_v<T, std::string_view> ||
+    std::is_same_v<T, const char *> || std::is_same_v<T, char *> ||
+    (std::is_array_v<T> && std::is_same_v<std::remove_extent_t<T>, char>);
+
+// Strings are copied into the record and come back as views into it,
+// trivially copyable values are copied byte for byte. Anything else forces
+// the message to be formatted on the calling thread.
+template <typename T>
+inline constexpr bool IS_CAPTURABLE_ARG =
+    IS_LOG_VALUE<T> || IS_STRING_ARG<T> ||
+    (std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> &&
+     !std::is_array_v<T>);
+
+// A LogValue's capture, still tagged with the type whose Write() renders it.
+template <typename T> struct CapturedValue {
+  typename LogValue<T>::Captured value;
+};
+
+template <typename T> struct CapturedArgType {
+  using Type = std::conditional_t<IS_STRING_ARG<T>, std::string_view, T>;
+};
+
+template <typename T>
+  requires IS_LOG_VALUE<T>
+struct CapturedArgType<T> {
+  using Type = CapturedValue<std::remove_cv_t<T>>;
+};
+
+template <typename T> using CapturedArg = typename CapturedArgType<T>::Type;
+
+template <typename T> inline size_t capturedSize(const T &arg) {
+  if constexpr (IS_LOG_VALUE<T>)
+    return sizeof(typename LogValue<T>::Captured);
+  else if constexpr (IS_STRING_ARG<T>)
+    return sizeof(uint32) + std::string_view(arg).size();
+  else
+    return sizeof(T);
+}
+
+template <typename Out, typename T>
+inline void captureArg(Out &out, const T &arg) {
+  if constexpr (IS_LOG_VALUE<T>) {
+    const typename LogValue<T>::Captured captured = LogValue<T>::Capture(arg);
+    out.Write(&captured, sizeof(captured));
+  } else if constexpr (IS_STRING_ARG<T>) {
+    const std::string_view str(arg);
+    const uint32 len = static_cast<uint32>(str.size());
+    out.Write(&len, sizeof(len));
+    out.Write(str.data(), len);
+  } else {
+    out.Write(&arg, sizeof(T));
+  }
+}
+
+template <typename T> inline CapturedArg<T> readArg(const std::byte *&in) {
+  if constexpr (IS_LOG_VALUE<T>) {
+    CapturedArg<T> captured;
+    std::memcpy(&captured.value, in, sizeof(captured.value));
+    in += sizeof(captured.value);
+    return captured;
+  } else if constexpr (IS_STRING_ARG<T>) {
+    uint32 len;
+    std::memcpy(&len, in, sizeof(len));
+    const std::string_view str(reinterpret_cast<const char *>(in + sizeof(len)),
+                               len);
+    in += sizeof(len) + len;
+    return str;
+  } else {
+    alignas(T) std::byte storage[sizeof(T)];
+    std::memcpy(storage, in, sizeof(T));
+    in += sizeof(T);
+    return *std::launder(reinterpret_cast<T *>(storage));
+  }
+}
+
+template <typename... Args>
+inline constexpr bool ARE_CAPTURABLE_ARGS = (IS_CAPTURABLE_ARG<Args> && ...);
+
+// Returns false when the arguments cannot be captured or do not fit.
+template <typename... Args>
+inline bool captureArgs(std::byte *out, size_t capacity, uint32 &bytes,
+                        const Args &...args) noexcept {
+  if constexpr (ARE_CAPTURABLE_ARGS<Args...>) {
+    const size_t total = (size_t{0} + ... + capturedSize(args));
+    if (total > capacity)
+      return false;
+
+    SpanWriter writer{out};
+    (captureArg(writer, args), ...);
+    bytes = static_cast<uint32>(total);
+    return true;
+  } else {
+    return false;
+  }
+}
+
+// Output iterator appending to a string.
+struct StringOutput {
+  using difference_type = std::ptrdiff_t;
+
+  string *str;
+
+  inline StringOutput &operator=(char c) {
+    str->push_back(c);
+    return *this;
+  }
+  inline StringOutput &operator*() noexcept { return *this; }
+  inline StringOutput &operator++() noexcept { return *this; }
+  inline StringOutput &operator++(int) noexcept { return *this; }
+};
+
+// Output iterator over a fixed buffer that drops whatever does not fit.
+struct BoundedOutput {
+  using difference_type = std::ptrdiff_t;
+
+  char *pos;
+  char *end;
+
+  inline BoundedOutput &operator=(char c) noexcept {
+    if (pos != end)
+      *pos++ = c;
+    return *this;
+  }
+  inline BoundedOutput &operator*() noexcept { return *this; }
+  inline BoundedOutput &operator++() noexcept { return *this; }
+  inline BoundedOutput &operator++(int) noexcept { return *this; }
+};
+
+// Whole runs of text, without going through the iterator a char at a time.
+inline void appendText(StringOutput &out, std::string_view text) {
+  out.str->append(text);
+}
+
+inline void appendText(PayloadOutput &out, std::string_view text) {
+  out.writer->Write(text.data(), text.size());
+}
+
+inline void appendText(BoundedOutput &out, std::string_view text) noexcept {
+  const size_t size =
+      std::min(text.size(), static_cast<size_t>(out.end - out.pos));
+  std::memcpy(out.pos, text.data(), size);
+  out.pos += size;
+}
+
+// One replacement field: LogValues write themselves, strings and chars are
+// copied as they are and numbers go through std::to_chars. Anything else,
+// or any field with a spec, goes through its std::formatter.
+template <typename Out, typename T>
+inline void formatField(Out &out, std::string_view spec, const T &value) {
+  if constexpr (IS_LOG_VALUE<T>) {
+    using Value = LogValue<std::remove_cv_t<T>>;
+    LogWriter writer;
+    Value::Write(writer, Value::Capture(value));
+    appendText(out, writer.View());
+    return;
+  } else if constexpr (IS_STRING_ARG<T>) {
+    if (spec.empty()) {
+      appendText(out, std::string_view(value));
+      return;
+    }
+  } else if constexpr (std::is_same_v<T, char>) {
+    if (spec.empty()) {
+      appendText(out, std::string_view(&value, 1));
+      return;
+    }
+  } else if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+    if (spec.empty()) {
+      LogWriter writer;
+      writer.Number(value);
+      appendText(out, writer.View());
+      return;
+    }
+  }
+  if (spec.empty())
+    out = std::format_to(out, "{}", value);
+  else
+    out = std::vformat_to(out, spec, std::make_format_args(value));
+}
+
+template <typename Out, typename T>
+inline void formatField(Out &out, std::string_view,
+                        const CapturedValue<T> &captured) {
+  LogWriter writer;
+  LogValue<T>::Write(writer, captured.value);
+  appendText(out, writer.View());
+}
+
+template <typename Out, typename... Args>
+inline void formatArg(Out &out, [[maybe_unused]] std::string_view spec,
+                      [[maybe_unused]] size_t index, const Args &...args) {
+  [[maybe_unused]] size_t i = 0;
+  ((i++ == index ? formatField(out, spec, args) : void()), ...);
+}
+
+// Formats a message through its site's pre-parsed segments, so the format
+// string is never parsed again at runtime; each call site instantiates it
+// for its own argument types.
+template <typename Out, typename... Args>
+inline Out formatPlanned(const LogSite &site, Out out, const Args &...args) {
+  const FormatPlan &plan = site.plan;
+  if (!plan.usable)
+    return std::vformat_to(out, site.fmt, std::make_format_args(args...));
+
+  for (uint8 i = 0; i < plan.count; ++i) {
+    const FormatSegment &segment = plan.segments[i];
+    const std::string_view text = site.fmt.substr(segment.begin, segment.size);
+    if (segment.arg < 0)
+      appendText(out, text);
+    else
+      formatArg(out, segment.spec ? text : std::string_view(),
+                static_cast<size_t>(segment.arg), args...);
+  }
+  return out;
+}
+
+template <typename... Args>
+inline void formatCaptured(const LogSite &site, const std::byte *args,
+                           string &out) {
+  [[maybe_unused]] const std::byte *in = args;
+  // Braced initialisation guarantees left-to-right evaluation of readArg.
+  std::tuple<CapturedArg<Args>...> values{readArg<Args>(in)...};
+  std::apply(
+      [&site, &out](auto &...vals) {
+        formatPlanned(site, StringOutput{&out}, vals...);
+      },
+      values);
+}
+
+template <typename T> inline constexpr LogArgType argType() {
+  using U = std::remove_cv_t<T>;
+  // LogValues only make sense to their own Write().
+  if constexpr (IS_LOG_VALUE<U>)
+    return LogArgType::Opaque;
+  else if constexpr (IS_STRING_ARG<U>)
+    return LogArgType::String;
+  else if constexpr (std::is_same_v<U, bool>)
+    return LogArgType::Bool;
+  else if constexpr (std::is_same_v<U, char>)
+    return LogArgType::Char;
+  else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>)
+    return sizeof(U) == 1   ? LogArgType::Int8
+           : sizeof(U) == 2 ? LogArgType::Int16
+           : sizeof(U) == 4 ? LogArgType::Int32
+                            : LogArgType::Int64;
+  else if constexpr (std::is_integral_v<U> && sizeof(U) <= 8)
+    return sizeof(U) == 1   ? LogArgType::UInt8
+           : sizeof(U) == 2 ? LogArgType::UInt16
+           : sizeof(U) == 4 ? LogArgType::UInt32
+                            : LogArgType::UInt64;
+  else if constexpr (std::is_same_v<U, float>)
+    return LogArgType::Float32;
+  else if constexpr (std::is_same_v<U, double>)
+    return LogArgType::Float64;
+  else
+    return LogArgType::Opaque;
+}
+
+template <typename... Args>
+inline constexpr std::array<LogArgType, sizeof...(Args)> ARG_TYPES{
+    argType<Args>()...};
+
+template <typename... Args> inline constexpr DeferredFormatFn capturedFormat() {
+  if constexpr (ARE_CAPTURABLE_ARGS<Args...>)
+    return &formatCaptured<Args...>;
+  else
+    return nullptr;
+}
+
+template <typename... Args>
+inline constexpr LogArgCodec ARG_CODEC{
+    capturedFormat<Args...>(),
+    ARG_TYPES<Args...>.data(),
+    sizeof...(Args),
+    ((argType<Args>() != LogArgType::Opaque) && ...),
+};
+
+} // namespace detail
+
+// Bounded ring of fixed slots. Every slot carries a sequence number telling
+// producers and consumers whose turn it is, so neither side ever takes a lock.
+// Pops are safe from any thread, which lets a producer evict the oldest entry
+// when the ring is full. A single-producer ring skips the CAS on push.
+template <typename T, size_t Capacity, bool MultiProducer> class BoundedRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "BoundedRing capacity must be a power of two");
+
+  static constexpr size_t MASK = Capacity - 1;
+
+  struct alignas(CACHE_LINE_SIZE) Slot {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+public:
+  static constexpr size_t CAPACITY = Capacity;
+  // Size of one slot, sequence number and padding included.
+  static constexpr size_t SLOT_SIZE = sizeof(Slot);
+
+  inline BoundedRing() {
+    for (size_t i = 0; i < Capacity; ++i)
+      _slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  BoundedRing(const BoundedRing &) = delete;
+  BoundedRing &operator=(const BoundedRing &) = delete;
+
+  // Returns false, leaving `value` untouched, when the ring is full.
+  inline bool TryPush(T &&value) noexcept {
+    return TryEmplace([&value](T &slot) { slot = std::move(value); });
+  }
+
+  // Claims a slot and lets `fill` write the entry in place. Returns false,
+  // without calling `fill`, when the ring is full.
+  template <typename Fill> inline bool TryEmplace(Fill &&fill) noexcept {
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = _slots[pos & MASK];
+      const size_t seq = slot.seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff < 0)
+        return false;
+
+      if constexpr (!MultiProducer) {
+        _tail.store(pos + 1, std::memory_order_relaxed);
+      } else if (diff != 0 || !_tail.compare_exchange_weak(
+                                  pos, pos + 1, std::memory_order_relaxed)) {
+        pos = _tail.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      fill(slot.value);
+      slot.seq.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+  }
+
+  inline bool TryPop(T &out) noexcept {
+    size_t pos = _head.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = _slots[pos & MASK];
+      const size_t seq = slot.seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff < 0)
+        return false;
+
+      if (diff == 0 && _head.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed)) {
+        out = std::move(slot.value);
+        slot.seq.store(pos + Capacity, std::memory_order_release);
+        return true;
+      }
+      pos = _head.load(std::memory_order_relaxed);
+    }
+  }
+
+  inline bool Empty() const noexcept {
+    const size_t pos = _head.load(std::memory_order_relaxed);
+    return _slots[pos & MASK].seq.load(std::memory_order_acquire) != pos + 1;
+  }
+
+  // Only a snapshot; producers and consumers may move it immediately.
+  inline size_t SizeApprox() const noexcept {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    const size_t head = _head.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+private:
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> _tail = 0;
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> _head = 0;
+  alignas(CACHE_LINE_SIZE) std::array<Slot, Capacity> _slots;
+};
+
+template <typename T, size_t Capacity>
+using MpscRing = BoundedRing<T, Capacity, true>;
+
+template <typename T, size_t Capacity>
+using SpscRing = BoundedRing<T, Capacity, false>;
+
+static_assert(MpscRing<LogMessage, 2>::SLOT_SIZE == LOG_MESSAGE_SLOT_SIZE,
+              "LogMessage no longer fills its ring slot exactly");
+
+// Converts ticks captured on producers into wall-clock time on the worker.
+// TSC ticks are measured against steady_clock once at startup and refined
+// about once a second as the measured interval grows. Worker only.
+class TickClock {
+public:
+  inline TickClock()
+      : _tick0(detail::tick()), _steady0(std::chrono::steady_clock::now()),
+        _wall0(LogClock::now()) {}
+
+  // Blocks for a couple of milliseconds to get a first TSC rate.
+  inline void Calibrate() {
+#ifdef BB_LOG_HAS_TSC
+    while (std::chrono::steady_clock::now() - _steady0 <
+           std::chrono::milliseconds(2)) {
+    }
+    recalibrate(detail::tick());
+#endif
+  }
+
+  // Current estimate of the tick length.
+  inline float64 NsPerTick() const noexcept {
+#ifdef BB_LOG_HAS_TSC
+    return _nsPerTick;
+#else
+    using Period = std::chrono::steady_clock::period;
+    return 1e9 * static_cast<float64>(Period::num) /
+           static_cast<float64>(Period::den);
+#endif
+  }
+
+  inline LogClock::time_point ToWall(uint64 tick) {
+    const auto elapsed = static_cast<int64>(tick - _tick0);
+#ifdef BB_LOG_HAS_TSC
+    if (static_cast<int64>(tick - _lastCalibration) > _ticksPerSecond)
+      recalibrate(tick);
+    const auto ns =
+        static_cast<int64>(static_cast<float64>(elapsed) * _nsPerTick);
+    return _wall0 + std::chrono::duration_cast<LogClock::duration>(
+                        std::chrono::nanoseconds(ns));
+#else
+    return _wall0 + std::chrono::duration_cast<LogClock::duration>(
+                        std::chrono::steady_clock::duration(elapsed));
+#endif
+  }
+
+private:
+#ifdef BB_LOG_HAS_TSC
+  inline void recalibrate(uint64 tick) {
+    const uint64 now = detail::tick();
+    const auto steadyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - _steady0)
+                              .count();
+    const auto ticks = static_cast<int64>(now - _tick0);
+    if (ticks <= 0 || steadyNs <= 0)
+      return;
+
+    _nsPerTick = static_cast<float64>(steadyNs) / static_cast<float64>(ticks);
+    _ticksPerSecond = static_cast<int64>(1e9 / _nsPerTick);
+    _lastCalibration = tick;
+  }
+
+  float64 _nsPerTick = 1.0;
+  int64 _ticksPerSecond = 0;
+  uint64 _lastCalibration = 0;
+#endif
+
+  uint64 _tick0;
+  std::chrono::steady_clock::time_point _steady0;
+  LogClock::time_point _wall0;
+};
+
+// Renders local time as "YYYY-MM-DD HH:MM:SS" followed by the fractional
+// digits of the chosen precision. The date and time part is cached and only
+// re-rendered when the second changes. Worker only.
+class TimestampFormatter {
+public:
+  inline std::string_view Format(LogClock::time_point when,
+                                 TimestampPrecision precision) {
+    constexpr int64 NS_PER_SECOND = 1'000'000'000;
+    const int64 ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         when.time_since_epoch())
+                         .count();
+    int64 second = ns / NS_PER_SECOND;
+    int64 fraction = ns % NS_PER_SECOND;
+    if (fraction < 0) {
+      --second;
+      fraction += NS_PER_SECOND;
+    }
+
+    if (second != _cachedSecond) {
+      const std::time_t time = static_cast<std::time_t>(second);
+      std::tm local{};
+#ifdef _WIN32
+      localtime_s(&local, &time);
+#else
+      localtime_r(&time, &local);
+#endif
+      std::strftime(_buffer, sizeof(_buffer), "%Y-%m-%d %H:%M:%S", &local);
+      _cachedSecond = second;
+    }
+
+    constexpr size_t PREFIX_LENGTH = 19;
+    const int digits = static_cast<int>(precision) * 3;
+    if (digits == 0)
+      return {_buffer, PREFIX_LENGTH};
+
+    for (int i = digits; i < 9; ++i)
+      fraction /= 10;
+
+    _buffer[PREFIX_LENGTH] = '.';
+    for (int i = digits; i > 0; --i) {
+      _buffer[PREFIX_LENGTH + i] = static_cast<char>('0' + fraction % 10);
+      fraction /= 10;
+    }
+    return {_buffer, PREFIX_LENGTH + 1 + digits};
+  }
+
+private:
+  char _buffer[32] = {};
+  int64 _cachedSecond = std::numeric_limits<int64>::min();
+};
+
+// Snapshot returned by Logger::Stats(), totals since the Logger started.
+// Call time is what producers spent queueing messages, waits on a full
+// queue included; latency runs from the call site's tick until the worker
+// hands the message to its sinks. Percentiles are rounded up to a power of
+// two nanoseconds.
+struct LoggerStats {
+  uint64 enqueued = 0;       // Messages accepted into a queue.
+  uint64 bytes = 0;          // Payload bytes of those messages.
+  uint64 dropped = 0;        // Discarded by the overflow policy or a sink.
+  uint64 written = 0;        // Messages handed to sinks, zones included.
+  size_t queueHighWater = 0; // Deepest backlog seen, all queues together.
+  std::chrono::nanoseconds callTime{};
+  std::chrono::nanoseconds maxCallTime{};
+  std::chrono::nanoseconds latencyP50{};
+  std::chrono::nanoseconds latencyP99{};
+  std::chrono::nanoseconds maxLatency{};
+};
+
+// Totals of one PROFILE_SCOPE zone since profiling started or the last
+// ResetProfileStats(). Percentiles are rounded up like LoggerStats' ones.
+struct ZoneStats {
+  const LogSite *site = nullptr; // Zone name in fmt, plus where it is.
+  uint64 count = 0;
+  std::chrono::nanoseconds total{};
+  std::chrono::nanoseconds max{};
+  std::chrono::nanoseconds p50{};
+  std::chrono::nanoseconds p99{};
+};
+
+namespace detail {
+
+// Counters of one producer thread. Only that thread writes them, so updates
+// are relaxed load/store pairs on a cache line of its own, never RMWs.
+struct alignas(CACHE_LINE_SIZE) ThreadLogStats {
+  std::atomic<uint64> enqueued = 0;
+  std::atomic<uint64> bytes = 0;
+  std::atomic<uint64> dropped = 0;
+  std::atomic<uint64> callTicks = 0;
+  std::atomic<uint64> maxCallTicks = 0;
+  AtomicBool retired = false;
+};
+
+// Single-writer increment.
+inline void bump(std::atomic<uint64> &counter, uint64 by = 1) noexcept {
+  counter.store(counter.load(std::memory_order_relaxed) + by,
+                std::memory_order_relaxed);
+}
+
+inline void raise(std::atomic<uint64> &counter, uint64 value) noexcept {
+  if (value > counter.load(std::memory_order_relaxed))
+    counter.store(value, std::memory_order_relaxed);
+}
+
+// Upper bound of the bucket holding the `per100`th percentile of a
+// histogram whose bucket i counts values in [2^i, 2^(i+1)).
+template <size_t N>
+inline uint64 histogramPercentile(const std::array<uint64, N> &buckets,
+                                  uint64 per100) noexcept {
+  uint64 samples = 0;
+  for (const uint64 count : buckets)
+    samples += count;
+  uint64 seen = 0;
+  for (size_t i = 0; i < N && samples > 0; ++i) {
+    seen += buckets[i];
+    if (seen * 100 >= samples * per100)
+      return uint64{1} << (i + 1);
+  }
+  return 0;
+}
+
+// Appends `str` as a JSON string literal, escaping in place.
+inline void appendJsonString(string &out, std::string_view str) {
+  static constexpr char HEX[] = "0123456789abcdef";
+  out += '"';
+  size_t run = 0; // Characters that need no escaping are copied in runs.
+  for (size_t i = 0; i < str.size(); ++i) {
+    const auto c = static_cast<unsigned char>(str[i]);
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    out.append(str.data() + run, i - run);
+    run = i + 1;
+    out += '\\';
+    switch (c) {
+    case '"':
+      out += '"';
+      break;
+    case '\\':
+      out += '\\';
+      break;
+    case '\n':
+      out += 'n';
+      break;
+    case '\r':
+      out += 'r';
+      break;
+    case '\t':
+      out += 't';
+      break;
+    default:
+      out += "u00";
+      out += HEX[c >> 4];
+      out += HEX[c & 0xF];
+    }
+  }
+  out.append(str.data() + run, str.size() - run);
+  out += '"';
+}
+
+// Payload of a zone message, whose stamp is the tick the zone ended on.
+struct ZoneEvent {
+  uint64 begin;
+  uint32 thread; // Small id in order of each thread's first zone.
+  uint32 depth;  // Zones open on the thread around this one.
+};
+
+// Payload of a flush marker.
+struct FlushRequest {
+  uint64 sequence;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+inline uint32 zoneThreadId() noexcept {
+  static std::atomic<uint32> next = 1;
+  thread_local const uint32 id = next.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+} // namespace detail
+
+// A producer thread's private ring. Owned jointly by the thread (through a
+// thread_local handle) and the Logger, which frees it once the thread has
+// exited and the worker has drained what it left behind.
+struct ThreadLogBuffer {
+  SpscRing<LogMessage, LOG_THREAD_BUFFER_CAPACITY> ring;
+  AtomicBool retired = false;
+};
+
+// Lets one consumer thread sleep until producers hand it work, without the
+// producers paying for a notify while it is awake. The consumer spins
+// briefly, then yields, and only then parks on an atomic wait.
+class WorkerSignal {
+public:
+  // Producer side, after publishing work. Pairs with the fence in Wait():
+  // either the consumer sees the work before sleeping or we see it asleep.
+  inline void Notify() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleeping.load(std::memory_order_relaxed))
+      Wake();
+  }
+
+  inline void Wake() noexcept {
+    _wakeups.fetch_add(1, std::memory_order_relaxed);
+    _wakeups.notify_one();
+  }
+
+  // Consumer side: returns once `ready()` holds or Wake() was called.
+  template <typename Ready> inline void Wait(Ready &&ready) {
+    constexpr int SPIN_ROUNDS = 64;
+    constexpr int YIELD_ROUNDS = 16;
+
+    for (int i = 0; i < SPIN_ROUNDS + YIELD_ROUNDS; ++i) {
+      if (ready())
+        return;
+      if (i >= SPIN_ROUNDS)
+        std::this_thread::yield();
+    }
+
+    const uint32 seen = _wakeups.load(std::memory_order_relaxed);
+    _sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!ready())
+      _wakeups.wait(seen, std::memory_order_relaxed);
+    _sleeping.store(false, std::memory_order_relaxed);
+  }
+
+private:
+  alignas(CACHE_LINE_SIZE) AtomicBool _sleeping = false;
+  std::atomic<uint32> _wakeups = 0;
+};
+
+// A fully formatted message as sinks see it. Views are only valid for the
+// duration of the Sink::Write call.
+struct LogRecord {
+  const LogSite *site;
+  LogClock::time_point time;
+  std::string_view payload; // Empty when no accepting sink needs text.
+  bool toFile;
+  bool toConsole;
+  TimestampPrecision precision;
+  uint32 suppressed = 0; // See LogSuppressed.
+
+  // The captured arguments, or null when the message was formatted on the
+  // calling thread. Always set when the payload was not rendered.
+  const LogArgCodec *codec = nullptr;
+  const std::byte *args = nullptr;
+  uint32 argBytes = 0;
+};
+
+// Turns a record into the text a sink writes out.
+class LogFormatter {
+public:
+  virtual ~LogFormatter() = default;
+  virtual void Format(const LogRecord &record, string &out) = 0;
+};
+
+// How DefaultFormatter lays a record out.
+enum class LogLayout {
+  Coloured,    // Level colours, no timestamp: terminals.
+  Plain,       // The same without escape codes: pipes and redirects.
+  Timestamped, // Wall-clock time first, no colours: log files.
+};
+
+// The Logger's own layouts. Each sink renders its own, so an FLOG_* message
+// that reaches both the console and the file looks right in each.
+class DefaultFormatter final : public LogFormatter {
+public:
+  inline explicit DefaultFormatter(LogLayout layout = LogLayout::Coloured)
+      : _layout(layout) {}
+
+  inline void Format(const LogRecord &record, string &out) override {
+    const LogSite &site = *record.site;
+    switch (_layout) {
+    case LogLayout::Timestamped: {
+      const std::string_view time =
+          _timestamps.Format(record.time, record.precision);
+      std::format_to(std::back_inserter(out), "[{}] - [{}]", time,
+                     site.levelName);
+      AppendCategory(site, out);
+      std::format_to(std::back_inserter(out), " {}:{} in function '{}': {}",
+                     site.file, site.line, site.function, record.payload);
+      AppendSuppressed(record, out);
+      break;
+    }
+    case LogLayout::Plain:
+      std::format_to(std::back_inserter(out), "[{}]", site.levelName);
+      AppendCategory(site, out);
+      std::format_to(std::back_inserter(out), " {}:{} in function '{}': {}",
+                     site.file, site.line, site.function, record.payload);
+      AppendSuppressed(record, out);
+      break;
+    case LogLayout::Coloured: {
+      const char *reset = COLOR_RESET.data();
+      std::format_to(std::back_inserter(out), "{}[{}]", site.colour,
+                     site.levelName);
+      AppendCategory(site, out);
+      std::format_to(std::back_inserter(out), " {}:{} in function {}'{}'{}: {}",
+                     site.file, site.line, reset, site.function, site.colour,
+                     record.payload);
+      AppendSuppressed(record, out);
+      out += reset;
+      break;
+    }
+    }
+    out += '\n';
+  }
+
+  // " [Net]" after the level of categorised sites.
+  static inline void AppendCategory(const LogSite &site, string &out) {
+    if (!site.category)
+      return;
+    out += " [";
+    out += site.category->Name();
+    out += ']';
+  }
+
+  // The note rate-limited sites add to the message they let through.
+  static inline void AppendSuppressed(const LogRecord &record, string &out) {
+    if (record.suppressed > 0)
+      std::format_to(std::back_inserter(out), " (suppressed {} times)",
+                     record.suppressed);
+  }
+
+private:
+  LogLayout _layout;
+  TimestampFormatter _timestamps;
+};
+
+// Which messages a sink subscribes to: Console sinks get everything that
+// passed the console threshold, File sinks the FLOG_* messages that passed
+// the file threshold.
+enum class SinkRoute {
+  Console,
+  File,
+};
+
+// A destination for log records. Write() and Flush() are only ever called
+// from the thread consuming the sink: the Logger worker, or the sink's own
+// thread when it was registered with SinkOptions::dedicatedThread.
+class Sink {
+public:
+  // Console sinks default to the coloured layout, File sinks to the
+  // timestamped one.
+  inline explicit Sink(SinkRoute route = SinkRoute::Console)
+      : _route(route),
+        _formatter(std::make_unique<DefaultFormatter>(
+            route == SinkRoute::File ? LogLayout::Timestamped
+                                     : LogLayout::Coloured)) {}
+  virtual ~Sink() = default;
+
+  Sink(const Sink &) = delete;
+  Sink &operator=(const Sink &) = delete;
+
+  inline void SetLevel(LogLevel lvl) {
+    _level.store(lvl, std::memory_order_relaxed);
+  }
+
+  inline LogLevel Level() const noexcept {
+    return _level.load(std::memory_order_relaxed);
+  }
+
+  // Not synchronised with the consuming thread: set it before registering.
+  inline void SetFormatter(uptr<LogFormatter> formatter) {
+    _formatter = std::move(formatter);
+  }
+
+  // Size at which buffering sinks write out what they have collected.
+  inline void SetBatchBytes(size_t bytes) {
+    _batchBytes.store(bytes, std::memory_order_relaxed);
+  }
+
+  inline bool Accepts(const LogRecord &record) const noexcept {
+    if (record.site->level < Level())
+      return false;
+    return _route == SinkRoute::File ? record.toFile : record.toConsole;
+  }
+
+  virtual void Write(const LogRecord &record) = 0;
+  virtual void Flush() {}
+
+  // Flush() for Logger::Flush(): sinks whose destination can refuse writes
+  // may keep trying for up to `timeout`.
+  virtual void Drain(std::chrono::milliseconds timeout) {
+    (void)timeout;
+    Flush();
+  }
+
+  // Sinks that can work from the captured arguments alone return false, so
+  // the worker skips formatting when no other sink wants the text.
+  virtual bool NeedsText() const noexcept { return true; }
+
+protected:
+  inline void format(const LogRecord &record, string &out) {
+    _formatter->Format(record, out);
+  }
+
+  inline size_t batchBytes() const noexcept {
+    return _batchBytes.load(std::memory_order_relaxed);
+  }
+
+private:
+  SinkRoute _route;
+  std::atomic<LogLevel> _level = LogLevel::Trace;
+  uptr<LogFormatter> _formatter;
+  std::atomic<size_t> _batchBytes = LOG_BATCH_BYTES;
+};
+
+namespace detail {
+
+// Colours only make sense on a terminal, and NO_COLOR turns them off.
+inline bool stdoutWantsColour() noexcept {
+#ifdef BB_LOG_HAS_POSIX
+  return ::isatty(STDOUT_FILENO) && !std::getenv("NO_COLOR");
+#else
+  return !std::getenv("NO_COLOR");
+#endif
+}
+
+#ifdef BB_LOG_HAS_POSIX
+// A reader going away, a log collector or journald, must not raise SIGPIPE
+// in the game.
+#ifdef MSG_NOSIGNAL
+inline constexpr int SOCKET_SEND_FLAGS = MSG_NOSIGNAL;
+#else
+inline constexpr int SOCKET_SEND_FLAGS = 0;
+#endif
+#endif
+
+} // namespace detail
+
+// Batches formatted lines for stdout, coloured when it is a terminal. On
+// POSIX, stdout is written only while poll() reports it writable, and what
+// a slow reader cannot take yet waits for the next flush. A socket, such as
+// a service's stdout to journald, is sent to without blocking. Pipes and
+// terminals get PIPE_BUF pieces, so a paused pipe never blocks the worker;
+// a terminal still can, briefly, when its buffer fills mid-write. A regular
+// file, always writable, gets each batch in one write. Lines that would
+// grow the backlog past LOG_CONSOLE_BACKLOG_BYTES are dropped and counted.
+class ConsoleSink : public Sink {
+public:
+  inline ConsoleSink() : Sink(SinkRoute::Console) {
+#ifdef BB_LOG_HAS_POSIX
+    struct stat info;
+    if (::fstat(STDOUT_FILENO, &info) == 0) {
+      _regularFile = S_ISREG(info.st_mode);
+      _socket = S_ISSOCK(info.st_mode);
+      _pieces = S_ISFIFO(info.st_mode) || ::isatty(STDOUT_FILENO);
+    }
+#endif
+    if (!detail::stdoutWantsColour())
+      SetFormatter(std::make_unique<DefaultFormatter>(LogLayout::Plain));
+  }
+
+  inline ~ConsoleSink() override { send(LOG_CONSOLE_DRAIN_TIMEOUT); }
+
+  inline void Write(const LogRecord &record) override {
+    const size_t before = _batch.size();
+    format(record, _batch);
+    if (_batch.size() - _sent > LOG_CONSOLE_BACKLOG_BYTES) {
+      _batch.resize(before);
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      ++_unreported;
+      return;
+    }
+    if (_batch.size() - _sent >= batchBytes())
+      Flush();
+  }
+
+  inline void Flush() override { send(std::chrono::milliseconds(0)); }
+
+  inline void Drain(std::chrono::milliseconds timeout) override {
+    send(timeout);
+  }
+
+  // Lines dropped because stdout was not keeping up.
+  inline uint64 Dropped() const noexcept {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Writes as much of the backlog as stdout takes within `timeout`. Once it
+  // is all out, notes how many lines were dropped meanwhile.
+  inline void send(std::chrono::milliseconds timeout) {
+    if (_sent == _batch.size())
+      return;
+
+#ifdef BB_LOG_HAS_POSIX
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (_sent < _batch.size()) {
+      size_t chunk = _batch.size() - _sent;
+      if (!_regularFile && !waitWritable(deadline))
+        break;
+
+      // A pipe that polls writable has room for PIPE_BUF bytes, so the
+      // write cannot block; a terminal makes no such promise. Ending pieces
+      // on a line break keeps lines whole when several Loggers share
+      // stdout.
+      if (_pieces)
+        chunk = std::min<size_t>(chunk, PIPE_BUF);
+      if (chunk < _batch.size() - _sent) {
+        const size_t lineEnd =
+            std::string_view(_batch.data() + _sent, chunk).rfind('\n');
+        if (lineEnd != std::string_view::npos)
+          chunk = lineEnd + 1;
+      }
+      // MSG_DONTWAIT leaves the descriptor, shared with the rest of the
+      // process, blocking.
+      const ssize_t written =
+          _socket ? ::send(STDOUT_FILENO, _batch.data() + _sent, chunk,
+                           MSG_DONTWAIT | detail::SOCKET_SEND_FLAGS)
+                  : ::write(STDOUT_FILENO, _batch.data() + _sent, chunk);
+      if (written < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+          continue;
+        _sent = _batch.size();
+        break;
+      }
+      _sent += static_cast<size_t>(written);
+    }
+#else
+    (void)timeout;
+    std::fwrite(_batch.data() + _sent, 1, _batch.size() - _sent, stdout);
+    std::fflush(stdout);
+    _sent = _batch.size();
+#endif
+
+    if (_sent < _batch.size()) {
+      // Keep the backlog from creeping through an ever larger buffer.
+      if (_sent >= _batch.size() / 2) {
+        _batch.erase(0, _sent);
+        _sent = 0;
+      }
+      return;
+    }
+    _batch.clear();
+    _sent = 0;
+    if (_unreported > 0) {
+      std::format_to(std::back_inserter(_batch),
+                     "[WARN] dropped {} console line(s): stdout was not "
+                     "keeping up\n",
+                     _unreported);
+      _unreported = 0;
+      send(timeout);
+    }
+  }
+
+#ifdef BB_LOG_HAS_POSIX
+  // False once `deadline` passes, or when stdout is gone, in which case the
+  // backlog is discarded.
+  inline bool
+  waitWritable(std::chrono::steady_clock::time_point deadline) noexcept {
+    for (;;) {
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      pollfd out{.fd = STDOUT_FILENO, .events = POLLOUT, .revents = 0};
+      const int ready =
+          ::poll(&out, 1, static_cast<int>(std::max<int64>(left.count(), 0)));
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready <= 0)
+        return false;
+      if (out.revents & (POLLERR | POLLNVAL)) {
+        _sent = _batch.size(); // Nowhere to write to: discard.
+        return false;
+      }
+      return true;
+    }
+  }
+#endif
+
+  bool _regularFile = false; // Written without polling.
+  bool _socket = false;      // Sent to without blocking.
+  bool _pieces = true;       // A pipe or terminal: PIPE_BUF at a time.
+  string _batch;
+  size_t _sent = 0; // Leading bytes of _batch already written.
+  uint64 _unreported = 0;
+  std::atomic<uint64> _dropped = 0;
+};
+
+// Records per entry of a log file's side index.
+inline constexpr uint32 LOG_INDEX_INTERVAL = 1024;
+
+// Side index of a log file, written next to it as "<log>.idx" by FileSink
+// and BinaryFileSink on request and read by tools/LogReplay: a header, then
+// one LogIndexEntry per block of records, so a reader can skip to the
+// blocks that may match a time range, level, category or source file
+// instead of scanning the whole log.
+inline constexpr std::string_view LOG_INDEX_MAGIC = "BBLI";
+inline constexpr uint16 LOG_INDEX_VERSION = 1;
+
+struct LogIndexHeader {
+  char magic[4];
+  uint16 version;
+  uint8 binary; // 1 when the log is in the binary layout.
+  uint8 reserved = 0;
+  uint32 interval;
+  uint32 reserved2 = 0;
+};
+
+// Integers in native byte order, like the binary log. Masks have bit
+// logIndexBit() set for each source file basename and category seen. In a
+// binary log each block starts a session, so it decodes on its own.
+struct LogIndexEntry {
+  uint64 offset; // Of the block's first record in the log.
+  uint64 bytes;
+  int64 minNanos; // Timestamps, since the epoch.
+  int64 maxNanos;
+  uint64 fileMask;
+  uint64 categoryMask;
+  uint32 records;
+  uint8 levelMask; // Bit `level` for each level seen.
+  uint8 reserved[3] = {};
+};
+
+static_assert(sizeof(LogIndexHeader) == 16 && sizeof(LogIndexEntry) == 56,
+              "the log index layout changed");
+
+namespace detail {
+
+// Case-insensitive FNV-1a, folded to a bit of a 64-bit mask.
+inline constexpr uint64 logIndexBit(std::string_view name) noexcept {
+  uint64 hash = 14695981039346656037ull;
+  for (char c : name) {
+    if (c >= 'A' && c <= 'Z')
+      c = static_cast<char>(c - 'A' + 'a');
+    hash = (hash ^ static_cast<uint8>(c)) * 1099511628211ull;
+  }
+  return uint64{1} << (hash & 63);
+}
+
+inline constexpr std::string_view baseName(std::string_view path) noexcept {
+  const size_t slash = path.find_last_of("/\\");
+  return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+
+inline std::filesystem::path logIndexPath(const std::filesystem::path &log) {
+  std::filesystem::path index = log;
+  index += ".idx";
+  return index;
+}
+
+// Builds a log's side index as its sink writes the records. Offsets assume
+// the sink is the file's only writer.
+class LogIndexWriter {
+public:
+  inline LogIndexWriter(const std::filesystem::path &log, bool binary,
+                        uint32 interval)
+      : _interval(std::max<uint32>(interval, 1)) {
+    const std::filesystem::path path = logIndexPath(log);
+    std::error_code error;
+    const bool fresh = std::filesystem::file_size(path, error) == 0 || error;
+    _file = std::fopen(path.string().c_str(), "ab");
+    if (!_file)
+      return;
+
+    std::setvbuf(_file, nullptr, _IONBF, 0);
+    if (fresh) {
+      LogIndexHeader header{};
+      std::memcpy(header.magic, LOG_INDEX_MAGIC.data(), sizeof(header.magic));
+      header.version = LOG_INDEX_VERSION;
+      header.binary = binary;
+      header.interval = _interval;
+      _batch.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+  }
+
+  inline ~LogIndexWriter() {
+    Flush();
+    if (_file)
+      std::fclose(_file);
+  }
+
+  LogIndexWriter(const LogIndexWriter &) = delete;
+  LogIndexWriter &operator=(const LogIndexWriter &) = delete;
+
+  // Called before `record` is written at `offset` in the log; true when it
+  // starts a new block.
+  inline bool Add(const LogRecord &record, uint64 offset) {
+    const bool starts = _entry.records == 0 || _entry.records == _interval;
+    if (_entry.records == _interval)
+      Finish(offset);
+    if (starts) {
+      _entry = {};
+      _entry.offset = offset;
+      _entry.minNanos = std::numeric_limits<int64>::max();
+      _entry.maxNanos = std::numeric_limits<int64>::min();
+    }
+
+    const LogSite &site = *record.site;
+    const int64 nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            record.time.time_since_epoch())
+                            .count();
+    _entry.minNanos = std::min(_entry.minNanos, nanos);
+    _entry.maxNanos = std::max(_entry.maxNanos, nanos);
+    _entry.fileMask |= logIndexBit(baseName(site.file));
+    if (site.category)
+      _entry.categoryMask |= logIndexBit(site.category->Name());
+    _entry.levelMask |= static_cast<uint8>(1u << static_cast<int>(site.level));
+    ++_entry.records;
+    return starts;
+  }
+
+  // Closes the current block at `end`, where the log's next record goes.
+  inline void Finish(uint64 end) {
+    if (_entry.records == 0)
+      return;
+
+    _entry.bytes = end - _entry.offset;
+    _batch.append(reinterpret_cast<const char *>(&_entry), sizeof(_entry));
+    _entry.records = 0;
+  }
+
+  inline void Flush() {
+    if (_batch.empty())
+      return;
+
+    if (_file)
+      std::fwrite(_batch.data(), 1, _batch.size(), _file);
+    _batch.clear();
+  }
+
+private:
+  uint32 _interval;
+  std::FILE *_file = nullptr;
+  string _batch;
+  LogIndexEntry _entry{};
+};
+
+} // namespace detail
+
+// Appends to a file, one unbuffered write per batch.
+class FileSink : public Sink {
+public:
+  inline explicit FileSink(const std::filesystem::path &path)
+      : Sink(SinkRoute::File), _path(path),
+        _file(std::fopen(path.string().c_str(), "a")) {
+    // Batches are already coalesced; let each one reach the kernel as is.
+    if (_file)
+      std::setvbuf(_file, nullptr, _IONBF, 0);
+  }
+
+  inline ~FileSink() override {
+    Flush();
+    if (_index) {
+      _index->Finish(_written);
+      _index->Flush();
+    }
+    if (_file)
+      std::fclose(_file);
+  }
+
+  inline bool IsOpen() const noexcept { return _file != nullptr; }
+
+  // Writes a side index next to the file, one entry per `interval` records
+  // (see LogIndexEntry). Call it before registering the sink.
+  inline void EnableIndex(uint32 interval = LOG_INDEX_INTERVAL) {
+    std::error_code error;
+    const uintmax_t size = std::filesystem::file_size(_path, error);
+    _written = error ? 0 : static_cast<uint64>(size);
+    _index = std::make_unique<detail::LogIndexWriter>(_path, false, interval);
+  }
+
+  inline void Write(const LogRecord &record) override {
+    if (_index)
+      _index->Add(record, _written + _batch.size());
+    format(record, _batch);
+    if (_batch.size() >= batchBytes())
+      Flush();
+  }
+
+  inline void Flush() override {
+    if (!_batch.empty()) {
+      if (_file)
+        std::fwrite(_batch.data(), 1, _batch.size(), _file);
+      _written += _batch.size();
+      _batch.clear();
+    }
+    // After the log, so no entry points past its end.
+    if (_index)
+      _index->Flush();
+  }
+
+private:
+  std::filesystem::path _path;
+  std::FILE *_file;
+  string _batch;
+  uint64 _written = 0; // Size of the file, as far as the index knows.
+  uptr<detail::LogIndexWriter> _index;
+};
+
+struct SinkOptions {
+  // Give the sink its own consumer thread fed by the Logger worker, so that
+  // a slow sink never delays the others. Records it cannot keep up with are
+  // dropped and counted rather than stalling the worker.
+  bool dedicatedThread = false;
+};
+
+namespace detail {
+
+// Owning copy of a LogRecord, queued to sinks with a dedicated thread.
+struct OwnedLogRecord {
+  const LogSite *site = nullptr;
+  LogClock::time_point time{};
+  string payload{};
+  bool toFile = false;
+  bool toConsole = false;
+  TimestampPrecision precision = TimestampPrecision::Milliseconds;
+  uint32 suppressed = 0;
+  const LogArgCodec *codec = nullptr;
+  bool captured = false;
+  uint32 argBytes = 0;
+  std::array<std::byte, LOG_ARG_BUFFER_SIZE> args{};
+
+  inline LogRecord View() const noexcept {
+    return {
+        .site = site,
+        .time = time,
+        .payload = payload,
+        .toFile = toFile,
+        .toConsole = toConsole,
+        .precision = precision,
+        .suppressed = suppressed,
+        .codec = codec,
+        .args = captured ? args.data() : nullptr,
+        .argBytes = argBytes,
+    };
+  }
+};
+
+// Drives one sink from its own thread.
+class SinkWorker {
+public:
+  inline explicit SinkWorker(std::shared_ptr<Sink> sink)
+      : _sink(std::move(sink)), _thread([this]() { run(); }) {}
+
+  inline ~SinkWorker() {
+    _running.store(false, std::memory_order_relaxed);
+    _signal.Wake();
+    _thread.join();
+  }
+
+  SinkWorker(const SinkWorker &) = delete;
+  SinkWorker &operator=(const SinkWorker &) = delete;
+
+  // Logger worker only. Returns false when the sink has fallen behind.
+  inline bool Push(const LogRecord &record) {
+    OwnedLogRecord owned{
+        .site = record.site,
+        .time = record.time,
+        .payload = string(record.payload),
+        .toFile = record.toFile,
+        .toConsole = record.toConsole,
+        .precision = record.precision,
+        .suppressed = record.suppressed,
+        .codec = record.codec,
+        .captured =
+            record.args != nullptr && record.argBytes <= LOG_ARG_BUFFER_SIZE,
+        .argBytes = record.argBytes,
+    };
+    if (owned.captured)
+      std::memcpy(owned.args.data(), record.args, record.argBytes);
+    if (!_ring.TryPush(std::move(owned)))
+      return false;
+
+    ++_pushed;
+    _signal.Notify();
+    return true;
+  }
+
+  // Logger worker only: waits until the sink thread has written and flushed
+  // every record pushed so far. False if `deadline` passed first.
+  inline bool WaitFlushed(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock lock(_flushMutex);
+    return _flushedCv.wait_until(lock, deadline,
+                                 [this]() { return _flushed >= _pushed; });
+  }
+
+private:
+  inline void run() {
+    OwnedLogRecord record;
+    uint64 written = 0;
+    while (_running.load(std::memory_order_relaxed)) {
+      while (_ring.TryPop(record)) {
+        _sink->Write(record.View());
+        ++written;
+      }
+      _sink->Flush();
+      {
+        std::lock_guard lock(_flushMutex);
+        _flushed = written;
+      }
+      _flushedCv.notify_all();
+
+      _signal.Wait([this]() {
+        return !_ring.Empty() || !_running.load(std::memory_order_relaxed);
+      });
+    }
+
+    while (_ring.TryPop(record))
+      _sink->Write(record.View());
+    _sink->Flush();
+  }
+
+  std::shared_ptr<Sink> _sink;
+  SpscRing<OwnedLogRecord, LOG_SINK_QUEUE_CAPACITY> _ring;
+  WorkerSignal _signal;
+  AtomicBool _running = true;
+  uint64 _pushed = 0; // Logger worker only.
+  std::mutex _flushMutex;
+  std::condition_variable _flushedCv;
+  uint64 _flushed = 0; // Records written by the last flush, under the mutex.
+  std::thread _thread;
+};
+
+} // namespace detail
+
+// Binary log layout written by BinaryFileSink and the flight recorder, and
+// read by tools/LogDecoder. Integers are stored in native byte order,
+// strings as a uint32 length then the bytes. A file is a sequence of
+// records, each starting with its kind:
+//
+//   Session  magic "BBLG", uint16 version. Starts every sink instance and
+//            dump; site ids restart from zero after it.
+//   Site     uint32 id, uint8 level, uint32 line, format, file and function
+//            strings, uint8 argument count, one LogArgType per argument,
+//            then from version 2 on the category name (empty without one).
+//            Written before the first message that refers to the id.
+//   Message  uint32 site id, int64 nanoseconds since the epoch, uint8 flags,
+//            uint32 suppressed count if LOG_BINARY_SUPPRESSED is set,
+//            uint32 payload size, payload. With LOG_BINARY_RAW_ARGS set the
+//            payload is the captured arguments, otherwise the message text.
+enum class BinaryLogRecord : uint8 {
+  Session = 1,
+  Site = 2,
+  Message = 3,
+};
+
+inline constexpr std::string_view LOG_BINARY_MAGIC = "BBLG";
+inline constexpr uint16 LOG_BINARY_VERSION = 2;
+
+// Message flags; the timestamp precision sits in the bits above them.
+inline constexpr uint8 LOG_BINARY_RAW_ARGS = 0x01;
+inline constexpr uint8 LOG_BINARY_SUPPRESSED = 0x02;
+inline constexpr uint8 LOG_BINARY_PRECISION_SHIFT = 4;
+
+// Keeps the last LOG_FLIGHT_RECORDER_CAPACITY messages in memory, written by
+// the calling thread itself so that nothing is lost with the worker's queue
+// when the process dies. Dump() only uses async-signal-safe calls and can run
+// from a crash handler; the dump is a binary log for tools/LogDecoder.
+class FlightRecorder {
+public:
+  inline explicit FlightRecorder(const std::filesystem::path &dumpPath) {
+    const string path = dumpPath.string();
+    const size_t size = std::min(path.size(), sizeof(_dumpPath) - 1);
+    std::memcpy(_dumpPath, path.data(), size);
+    _dumpPath[size] = '\0';
+  }
+
+#ifdef BB_LOG_HAS_POSIX
+  inline ~FlightRecorder() {
+    FlightRecorder *self = this;
+    crashRecorder().compare_exchange_strong(self, nullptr);
+  }
+#endif
+
+  FlightRecorder(const FlightRecorder &) = delete;
+  FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+  // Arguments the decoder can rebuild are copied raw, anything else is
+  // formatted and truncated to the slot.
+  template <typename... Args>
+  inline void Record(const LogSite &site, uint64 stamp,
+                     const Args &...args) noexcept {
+    const uint64 index = _head.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = _slots[index & (LOG_FLIGHT_RECORDER_CAPACITY - 1)];
+    // One writer per slot: if a writer a whole ring behind or ahead holds it
+    // or has moved past, this message is the one given up.
+    uint64 sequence = slot.sequence.load(std::memory_order_relaxed);
+    do {
+      if ((sequence & 1) != 0 || sequence > 2 * index)
+        return;
+    } while (!slot.sequence.compare_exchange_weak(sequence, 2 * index + 1,
+                                                  std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.site = &site;
+    slot.codec = &detail::ARG_CODEC<Args...>;
+    slot.stamp = stamp;
+    slot.raw = detail::ARG_CODEC<Args...>.portable &&
+               detail::captureArgs(slot.payload.data(), slot.payload.size(),
+                                   slot.size, args...);
+    if (!slot.raw) {
+      try {
+        auto *text = reinterpret_cast<char *>(slot.payload.data());
+        const detail::BoundedOutput end = detail::formatPlanned(
+            site, detail::BoundedOutput{text, text + slot.payload.size()},
+            args...);
+        slot.size = static_cast<uint32>(end.pos - text);
+      } catch (...) {
+        slot.size = 0;
+      }
+    }
+
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+  }
+
+  // Published by the Logger worker once it has calibrated its tick rate.
+  inline void SetNsPerTick(float64 nsPerTick) noexcept {
+    _nsPerTick.store(nsPerTick, std::memory_order_relaxed);
+  }
+
+#ifdef BB_LOG_HAS_POSIX
+  // Dumps on SIGSEGV, SIGABRT, SIGBUS, SIGFPE and SIGILL, then hands the
+  // signal on to whatever handler was installed before. The handlers run on
+  // an alternate stack, given to the calling thread here.
+  inline void InstallCrashHandlers() noexcept {
+    crashRecorder().store(this, std::memory_order_release);
+    UseCrashStack();
+    if (crashHandlersInstalled().exchange(true))
+      return;
+
+    struct sigaction action {};
+    action.sa_handler = &FlightRecorder::onCrash;
+    action.sa_flags = SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    for (size_t i = 0; i < CRASH_SIGNALS.size(); ++i)
+      ::sigaction(CRASH_SIGNALS[i], &action, &previousHandlers()[i]);
+  }
+
+  // Gives the calling thread an alternate signal stack, unless it has one,
+  // so that a crash by stack overflow still gets dumped. Call it on any
+  // thread besides the one that enabled the recorder.
+  static inline void UseCrashStack() noexcept {
+    stack_t current{};
+    if (::sigaltstack(nullptr, &current) != 0 ||
+        (current.ss_flags & SS_DISABLE) == 0)
+      return;
+
+    thread_local CrashStack stack;
+    if (stack.memory)
+      return;
+    stack.memory.reset(new (std::nothrow) std::byte[LOG_CRASH_STACK_SIZE]);
+    if (!stack.memory)
+      return;
+
+    stack_t alternate{};
+    alternate.ss_sp = stack.memory.get();
+    alternate.ss_size = LOG_CRASH_STACK_SIZE;
+    if (::sigaltstack(&alternate, nullptr) != 0)
+      stack.memory.reset();
+  }
+#endif
+
+  // Writes every complete slot, oldest first, to the dump path. Slots being
+  // written at that moment are skipped.
+  inline void Dump() noexcept {
+#ifdef BB_LOG_HAS_POSIX
+    const int fd = ::open(_dumpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          0644);
+    if (fd < 0)
+      return;
+#else
+    std::FILE *fd = std::fopen(_dumpPath, "wb");
+    if (!fd)
+      return;
+#endif
+
+    DumpWriter out{fd};
+    out.Put(BinaryLogRecord::Session);
+    out.Append(LOG_BINARY_MAGIC.data(), LOG_BINARY_MAGIC.size());
+    out.Put(LOG_BINARY_VERSION);
+
+    // Ticks become wall-clock time relative to now.
+    const uint64 tickNow = detail::tick();
+    const int64 wallNow = wallClockNs();
+    const float64 nsPerTick = _nsPerTick.load(std::memory_order_relaxed);
+
+    const uint64 head = _head.load(std::memory_order_acquire);
+    const uint64 first =
+        head - std::min<uint64>(head, LOG_FLIGHT_RECORDER_CAPACITY);
+    SlotCopy slot;
+    for (uint64 index = first; index < head; ++index) {
+      if (!copySlot(index, slot))
+        continue;
+
+      // Every slot gets a site entry of its own; ids are slot positions.
+      const uint32 id =
+          static_cast<uint32>(index & (LOG_FLIGHT_RECORDER_CAPACITY - 1));
+      const LogSite &site = *slot.site;
+      out.Put(BinaryLogRecord::Site);
+      out.Put(id);
+      out.Put(static_cast<uint8>(site.level));
+      out.Put(site.line);
+      out.PutString(site.fmt.data(), site.fmt.size());
+      out.PutString(site.file, std::strlen(site.file));
+      out.PutString(site.function, std::strlen(site.function));
+      out.Put(static_cast<uint8>(slot.codec->count));
+      out.Append(slot.codec->types, slot.codec->count);
+      const std::string_view category =
+          site.category ? site.category->Name() : std::string_view();
+      out.PutString(category.data(), category.size());
+
+      const auto age = static_cast<float64>(
+          static_cast<int64>(tickNow - slot.stamp));
+      const int64 nanos = wallNow - static_cast<int64>(age * nsPerTick);
+      const uint8 flags = static_cast<uint8>(
+          (slot.raw ? LOG_BINARY_RAW_ARGS : 0) |
+          (static_cast<uint8>(TimestampPrecision::Nanoseconds)
+           << LOG_BINARY_PRECISION_SHIFT));
+      out.Put(BinaryLogRecord::Message);
+      out.Put(id);
+      out.Put(nanos);
+      out.Put(flags);
+      out.PutString(slot.payload.data(), slot.size);
+    }
+
+    out.Flush();
+#ifdef BB_LOG_HAS_POSIX
+    ::close(fd);
+#else
+    std::fclose(fd);
+#endif
+  }
+
+private:
+#ifdef BB_LOG_HAS_POSIX
+  static constexpr std::array<int, 5> CRASH_SIGNALS = {SIGSEGV, SIGABRT, SIGBUS,
+                                                       SIGFPE, SIGILL};
+
+  static inline std::atomic<FlightRecorder *> &crashRecorder() noexcept {
+    static std::atomic<FlightRecorder *> recorder = nullptr;
+    return recorder;
+  }
+
+  static inline AtomicBool &crashHandlersInstalled() noexcept {
+    static AtomicBool installed = false;
+    return installed;
+  }
+
+  static inline std::array<struct sigaction, CRASH_SIGNALS.size()> &
+  previousHandlers() noexcept {
+    static std::array<struct sigaction, CRASH_SIGNALS.size()> handlers{};
+    return handlers;
+  }
+
+  static inline void onCrash(int signal) {
+    // Only the first crashing thread dumps.
+    if (FlightRecorder *recorder = crashRecorder().exchange(nullptr))
+      recorder->Dump();
+
+    for (size_t i = 0; i < CRASH_SIGNALS.size(); ++i) {
+      if (CRASH_SIGNALS[i] == signal)
+        ::sigaction(signal, &previousHandlers()[i], nullptr);
+    }
+    ::raise(signal);
+  }
+#endif
+
+  struct Slot {
+    std::atomic<uint64> sequence = 0; // Odd while being written.
+    const LogSite *site = nullptr;
+    const LogArgCodec *codec = nullptr;
+    uint64 stamp = 0;
+    uint32 size = 0;
+    bool raw = false;
+    std::array<std::byte, LOG_ARG_BUFFER_SIZE> payload{};
+  };
+
+  // A slot as Dump() read it.
+  struct SlotCopy {
+    const LogSite *site;
+    const LogArgCodec *codec;
+    uint64 stamp;
+    uint32 size;
+    bool raw;
+    std::array<std::byte, LOG_ARG_BUFFER_SIZE> payload;
+  };
+
+  // Copies the slot holding message `index`; false when it holds another
+  // message or was rewritten while being copied.
+  inline bool copySlot(uint64 index, SlotCopy &out) const noexcept {
+    const Slot &slot = _slots[index & (LOG_FLIGHT_RECORDER_CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != 2 * index + 2)
+      return false;
+
+    out.site = slot.site;
+    out.codec = slot.codec;
+    out.stamp = slot.stamp;
+    out.size = std::min<uint32>(slot.size, LOG_ARG_BUFFER_SIZE);
+    out.raw = slot.raw;
+    std::memcpy(out.payload.data(), slot.payload.data(), out.size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == 2 * index + 2;
+  }
+
+#ifdef BB_LOG_HAS_POSIX
+  // Switched off before its memory goes away with the thread.
+  struct CrashStack {
+    uptr<std::byte[]> memory;
+
+    inline ~CrashStack() {
+      if (!memory)
+        return;
+      stack_t off{};
+      off.ss_flags = SS_DISABLE;
+      ::sigaltstack(&off, nullptr);
+    }
+  };
+#endif
+
+  // Fixed stack buffer in front of write(2), nothing allocated.
+  struct DumpWriter {
+#ifdef BB_LOG_HAS_POSIX
+    int fd;
+#else
+    std::FILE *fd;
+#endif
+    size_t used = 0;
+    char buffer[4096] = {};
+
+    inline void Append(const void *data, size_t size) noexcept {
+      const auto *bytes = static_cast<const char *>(data);
+      while (size > 0) {
+        if (used == sizeof(buffer))
+          Flush();
+        const size_t chunk = std::min(size, sizeof(buffer) - used);
+        std::memcpy(buffer + used, bytes, chunk);
+        used += chunk;
+        bytes += chunk;
+        size -= chunk;
+      }
+    }
+
+    template <typename T> inline void Put(const T &value) noexcept {
+      Append(&value, sizeof(T));
+    }
+
+    inline void PutString(const void *data, size_t size) noexcept {
+      Put(static_cast<uint32>(size));
+      Append(data, size);
+    }
+
+    inline void Flush() noexcept {
+#ifdef BB_LOG_HAS_POSIX
+      for (size_t done = 0; done < used;) {
+        const ssize_t written = ::write(fd, buffer + done, used - done);
+        if (written <= 0)
+          break;
+        done += static_cast<size_t>(written);
+      }
+#else
+      std::fwrite(buffer, 1, used, fd);
+#endif
+      used = 0;
+    }
+  };
+
+  static inline int64 wallClockNs() noexcept {
+#ifdef BB_LOG_HAS_POSIX
+    timespec now;
+    ::clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<int64>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               LogClock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  // Ticks are steady_clock counts until the worker has measured the TSC.
+  static inline float64 defaultNsPerTick() noexcept {
+    using Period = std::chrono::steady_clock::period;
+    return 1e9 * static_cast<float64>(Period::num) /
+           static_cast<float64>(Period::den);
+  }
+
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64> _head = 0;
+  std::atomic<float64> _nsPerTick = defaultNsPerTick();
+  char _dumpPath[512] = {};
+  std::array<Slot, LOG_FLIGHT_RECORDER_CAPACITY> _slots{};
+};
+
+// Scheduling of the Logger worker, see Logger::SetWorkerOptions. Keep it off
+// the cores running hot threads and below their priority.
+struct WorkerOptions {
+  int32 cpu = -1;            // Core to pin the worker to; -1 lets it float.
+  int32 niceness = 0;        // Nice value; positive values lower priority.
+  string name = "bb-logger"; // Thread name; Linux keeps 15 characters.
+};
+
+namespace detail {
+
+// The calling thread's scheduling, for WorkerOptions. Each returns false
+// when the setting could not be applied; names are a hint and platforms
+// without them just ignore it.
+inline bool setThreadName(const string &name) {
+#if defined(__linux__)
+  return ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str()) ==
+         0;
+#elif defined(__APPLE__)
+  return ::pthread_setname_np(name.c_str()) == 0;
+#else
+  (void)name;
+  return true;
+#endif
+}
+
+inline bool setThreadAffinity(int32 cpu) {
+#ifdef __linux__
+  if (cpu >= CPU_SETSIZE)
+    return false;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+inline bool setThreadNiceness(int32 niceness) {
+#if defined(__linux__)
+  // Linux keeps a nice value per thread, addressed by its tid.
+  const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+  return ::setpriority(PRIO_PROCESS, tid, niceness) == 0;
+#elif defined(BB_LOG_HAS_POSIX)
+  // Elsewhere nice is per process: move the thread to the bottom of its
+  // policy's range instead, and refuse raising it.
+  if (niceness <= 0)
+    return niceness == 0;
+  int policy = 0;
+  sched_param param{};
+  if (::pthread_getschedparam(::pthread_self(), &policy, &param) != 0)
+    return false;
+  param.sched_priority = ::sched_get_priority_min(policy);
+  return ::pthread_setschedparam(::pthread_self(), policy, &param) == 0;
+#else
+  return niceness == 0;
+#endif
+}
+
+} // namespace detail
+
+// Worker side of PROFILE_SCOPE: a duration histogram per zone and, while a
+// trace is open, one Chrome trace-event ("ph":"X") per zone, which
+// chrome://tracing and Perfetto load as a timeline per thread. Record() is
+// called by the worker, everything else is safe from any thread.
+class ZoneProfiler {
+public:
+  ZoneProfiler() = default;
+  ZoneProfiler(const ZoneProfiler &) = delete;
+  ZoneProfiler &operator=(const ZoneProfiler &) = delete;
+
+  inline ~ZoneProfiler() { StopTrace(); }
+
+  inline void Record(const LogSite &site, LogClock::time_point begin,
+                     uint64 ns, const detail::ZoneEvent &event) {
+    std::lock_guard lock(_mutex);
+    Zone &zone = _zones[&site];
+    ++zone.count;
+    zone.totalNs += ns;
+    zone.maxNs = std::max(zone.maxNs, ns);
+    ++zone.buckets[std::min<size_t>(ns > 0 ? std::bit_width(ns) - 1 : 0,
+                                    LOG_LATENCY_BUCKETS - 1)];
+
+    // Zones already open when the trace started are left out.
+    if (!_trace || begin < _traceStart)
+      return;
+    const auto us = [](auto duration) {
+      return std::chrono::duration<float64, std::micro>(duration).count();
+    };
+    _traceBatch += _traceEvents++ > 0 ? ",\n{\"name\":" : "{\"name\":";
+    detail::appendJsonString(_traceBatch, site.fmt);
+    std::format_to(std::back_inserter(_traceBatch),
+                   ",\"cat\":\"zone\",\"ph\":\"X\",\"ts\":{:.3f},"
+                   "\"dur\":{:.3f},\"pid\":1,\"tid\":{},"
+                   "\"args\":{{\"depth\":{},\"line\":{},\"file\":",
+                   us(begin - _traceStart), us(std::chrono::nanoseconds(ns)),
+                   event.thread, event.depth, site.line);
+    detail::appendJsonString(_traceBatch, site.file);
+    _traceBatch += "}}";
+    if (_traceBatch.size() >= LOG_TRACE_BATCH_SIZE)
+      writeTraceLocked();
+  }
+
+  // Busiest zones first.
+  inline std::vector<ZoneStats> Snapshot() const {
+    std::vector<ZoneStats> stats;
+    std::lock_guard lock(_mutex);
+    stats.reserve(_zones.size());
+    for (const auto &[site, zone] : _zones) {
+      stats.push_back({
+          .site = site,
+          .count = zone.count,
+          .total = std::chrono::nanoseconds(zone.totalNs),
+          .max = std::chrono::nanoseconds(zone.maxNs),
+          .p50 = std::chrono::nanoseconds(
+              detail::histogramPercentile(zone.buckets, 50)),
+          .p99 = std::chrono::nanoseconds(
+              detail::histogramPercentile(zone.buckets, 99)),
+      });
+    }
+    std::ranges::sort(stats, std::greater{}, &ZoneStats::total);
+    return stats;
+  }
+
+  inline void Reset() {
+    std::lock_guard lock(_mutex);
+    _zones.clear();
+  }
+
+  // Replaces the open trace, if any. Timestamps count from this call.
+  inline bool StartTrace(const std::filesystem::path &path) {
+    std::FILE *file = std::fopen(path.string().c_str(), "wb");
+    if (!file)
+      return false;
+
+    std::lock_guard lock(_mutex);
+    closeTraceLocked();
+    _trace = file;
+    _traceStart = LogClock::now();
+    _traceEvents = 0;
+    _traceBatch = "[\n";
+    return true;
+  }
+
+  inline void StopTrace() {
+    std::lock_guard lock(_mutex);
+    closeTraceLocked();
+  }
+
+  inline void Flush() {
+    std::lock_guard lock(_mutex);
+    if (_trace && !_traceBatch.empty()) {
+      writeTraceLocked();
+      std::fflush(_trace);
+    }
+  }
+
+private:
+  struct Zone {
+    uint64 count = 0;
+    uint64 totalNs = 0;
+    uint64 maxNs = 0;
+    std::array<uint64, LOG_LATENCY_BUCKETS> buckets{};
+  };
+
+  inline void writeTraceLocked() {
+    std::fwrite(_traceBatch.data(), 1, _traceBatch.size(), _trace);
+    _traceBatch.clear();
+  }
+
+  inline void closeTraceLocked() {
+    if (!_trace)
+      return;
+    _traceBatch += "\n]\n";
+    writeTraceLocked();
+    std::fclose(_trace);
+    _trace = nullptr;
+  }
+
+  mutable std::mutex _mutex;
+  fmap<const LogSite *, Zone> _zones;
+  std::FILE *_trace = nullptr;
+  LogClock::time_point _traceStart{};
+  uint64 _traceEvents = 0;
+  string _traceBatch;
+};
+
+class Logger {
+public:
+  // The default Logger. Never destroyed, so that other static objects can
+  // still log from their destructors: an exit handler calls Shutdown()
+  // instead, after which messages are written by the calling thread.
+  inline static Logger &Self() {
+    static Logger *instance = [] {
+      auto *logger = new Logger();
+      std::atexit([] { Self().Shutdown(LOG_SHUTDOWN_TIMEOUT); });
+      return logger;
+    }();
+    return *instance;
+  }
+
+  // The process-wide Logger called `name`, created on first use with its
+  // own queues, worker, levels and sinks, and kept like Self(). An empty
+  // name is Self(). Files pick theirs for the LOG_* macros with BB_LOG_TAG.
+  inline static Logger &Get(std::string_view name) {
+    if (name.empty())
+      return Self();
+
+    struct Registry {
+      std::mutex mutex;
+      fmap<string, Logger *> loggers;
+    };
+    static Registry *registry = [] {
+      auto *created = new Registry();
+      std::atexit([] {
+        std::lock_guard lock(registry->mutex);
+        for (const auto &[loggerName, logger] : registry->loggers)
+          logger->Shutdown(LOG_SHUTDOWN_TIMEOUT);
+      });
+      return created;
+    }();
+
+    std::lock_guard lock(registry->mutex);
+    auto [it, inserted] = registry->loggers.try_emplace(string(name));
+    if (inserted)
+      it->second = new Logger(name);
+    return *it->second;
+  }
+
+  // An independent Logger, e.g. one per test or injected into a subsystem;
+  // the LOG_* macros only reach it through BB_LOG_LOGGER. It starts with
+  // its own console sink. Destroying it shuts it down.
+  inline explicit Logger(std::string_view name = {}) : _name(name) {
+    if (!_name.empty())
+      _workerOptions.name = "bb-log-" + _name;
+    _consoleSink = std::make_shared<ConsoleSink>();
+    addSinkLocked(_consoleSink, {});
+
+#ifdef BB_LOG_INLINE
+    calibrate();
+    _state.store(WorkerState::Stopped, std::memory_order_relaxed);
+#else
+    startWorker();
+#endif
+  }
+
+  // Waits for a worker whose flush timed out: it still refers to us.
+  inline ~Logger() {
+    Shutdown();
+    if (_workerThread.joinable())
+      _workerThread.join();
+
+    // A producer that saw the worker running just before it stopped may have
+    // queued after the last drain; nothing else would write that message.
+    {
+      std::lock_guard lock(_inlineMutex);
+      drainQueues();
+    }
+
+    // Sinks with their own thread drain and join as their entries go away.
+    _workerSinks.reset();
+    _sinks.reset();
+  }
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  inline const string &Name() const noexcept { return _name; }
+
+  // Console threshold. Applies to LOG_* and to the console copy of FLOG_*.
+  inline void SetLevel(LogLevel lvl) {
+    _level.store(lvl, std::memory_order_relaxed);
+    updateGates();
+  }
+
+  // File threshold, independent of the console one.
+  inline void SetFileLevel(LogLevel lvl) {
+    _fileLevel.store(lvl, std::memory_order_relaxed);
+    updateGates();
+  }
+
+  // The runtime filters. The macros call them before evaluating any of their
+  // arguments; Log() and LogToFile() do not filter again.
+  // True when a LOG_* message would reach the console or the flight recorder.
+  inline bool ShouldLog(LogLevel lvl) const noexcept {
+    return lvl >= _gate.load(std::memory_order_relaxed);
+  }
+
+  // True when a FLOG_* message would reach the file, the console or the
+  // flight recorder.
+  inline bool ShouldLogToFile(LogLevel lvl) const noexcept {
+    return lvl >= _fileGate.load(std::memory_order_relaxed);
+  }
+
+  // Starts keeping the last messages at or above `lvl` in memory, whatever
+  // the console and file thresholds, and dumps them to `dumpPath` on
+  // LOG_FATAL and, if `handleCrashes` is set, on a crash signal (POSIX
+  // only). The dump path is fixed by the first call. Statements removed by
+  // BB_LOG_ACTIVE_LEVEL are never recorded.
+  inline void EnableFlightRecorder(
+      LogLevel lvl = LogLevel::Trace,
+      const std::filesystem::path &dumpPath = "./flight.bblog",
+      bool handleCrashes = true) {
+    {
+      std::lock_guard lock(_mutex);
+      if (!_recorder.load(std::memory_order_relaxed)) {
+        _recorderStorage = std::make_unique<FlightRecorder>(dumpPath);
+        _recorder.store(_recorderStorage.get());
+        _recorderStorage->SetNsPerTick(_nsPerTick.load());
+      }
+    }
+#ifdef BB_LOG_HAS_POSIX
+    if (handleCrashes)
+      _recorderStorage->InstallCrashHandlers();
+#else
+    (void)handleCrashes;
+#endif
+    _recorderLevel.store(lvl, std::memory_order_relaxed);
+    updateGates();
+  }
+
+  // Stops recording; what was recorded can still be dumped.
+  inline void DisableFlightRecorder() {
+    _recorderLevel.store(LogLevel::Off, std::memory_order_relaxed);
+    updateGates();
+  }
+
+  inline void DumpFlightRecorder() noexcept {
+    if (FlightRecorder *recorder = _recorder.load(std::memory_order_acquire))
+      recorder->Dump();
+  }
+
+  // Blocks until every message queued before the call has been written and
+  // flushed by every sink, dedicated sink threads included. Returns false if
+  // that took longer than `timeout`; the flush still completes later.
+  inline bool Flush(std::chrono::milliseconds timeout = LOG_FLUSH_TIMEOUT) {
+    const WorkerState state = _state.load(std::memory_order_acquire);
+    if (state != WorkerState::Running) {
+      if (state == WorkerState::Abandoned)
+        return false;
+      std::lock_guard lock(_inlineMutex);
+      drainQueues();
+      return true;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    const detail::FlushRequest request{
+        .sequence = _flushRequested.fetch_add(1) + 1, .deadline = deadline};
+    auto fill = [&](LogMessage &msg) {
+      msg.site = nullptr;
+      msg.codec = &detail::ARG_CODEC<>;
+      msg.stamp = detail::tick();
+      msg.suppressed = 0;
+      msg.toFile = false;
+      msg.toConsole = false;
+      msg.captured = false;
+      msg.kind = LogMessageKind::Flush;
+      detail::PayloadWriter(msg).Write(&request, sizeof(request));
+    };
+
+    // Markers wait for room whatever the overflow policy. The shared queue
+    // will do even with per-thread buffers: the worker merges it with them
+    // by tick.
+    while (!_logQ.TryEmplace(fill)) {
+      if (std::chrono::steady_clock::now() >= deadline)
+        return false;
+      std::this_thread::yield();
+    }
+    _signal.Notify();
+
+    std::unique_lock lock(_flushMutex);
+    return _flushedCv.wait_until(lock, deadline, [&]() {
+      return _flushedSequence >= request.sequence;
+    });
+  }
+
+  // Flushes, then stops the worker for good: messages logged afterwards are
+  // written inline by the calling thread. If the flush times out, the
+  // worker is left to finish on its own, joined only by ~Logger(), and
+  // later messages are dropped.
+  // Runs at exit with LOG_SHUTDOWN_TIMEOUT; calling it again does nothing.
+  inline bool
+  Shutdown(std::chrono::milliseconds timeout = LOG_SHUTDOWN_TIMEOUT) {
+    std::lock_guard shutdown(_shutdownMutex);
+    const WorkerState state = _state.load(std::memory_order_acquire);
+    _shutDown = true;
+    if (state != WorkerState::Running)
+      return state == WorkerState::Stopped;
+    return stopWorker(timeout);
+  }
+
+  // Inline mode has no worker: every message is formatted and written by
+  // the calling thread, under a lock, before the call returns. Cheaper than
+  // the hop to the worker for single-threaded tools and tests. Defining
+  // BB_LOG_INLINE starts the Logger in this mode, without a worker ever
+  // being created. Leaving it starts a new worker, except after Shutdown().
+  inline bool
+  SetInlineMode(bool enable,
+                std::chrono::milliseconds timeout = LOG_FLUSH_TIMEOUT) {
+    std::lock_guard shutdown(_shutdownMutex);
+    const WorkerState state = _state.load(std::memory_order_acquire);
+    if (enable)
+      return state != WorkerState::Running ? state == WorkerState::Stopped
+                                           : stopWorker(timeout);
+    if (state != WorkerState::Stopped || _shutDown)
+      return state == WorkerState::Running;
+
+    std::lock_guard lock(_inlineMutex);
+    startWorker();
+    return true;
+  }
+
+  inline bool IsInlineMode() const noexcept {
+    return _state.load(std::memory_order_relaxed) == WorkerState::Stopped;
+  }
+
+  // Worker thread scheduling, set by the worker on itself at its next
+  // wakeup. Settings the platform refuses are reported as warnings.
+  inline void SetWorkerOptions(WorkerOptions options) {
+    {
+      std::lock_guard lock(_mutex);
+      _workerOptions = std::move(options);
+    }
+    _workerOptionsVersion.fetch_add(1, std::memory_order_release);
+    _signal.Wake();
+  }
+
+  // When enabled, arguments are captured raw and formatted on the worker
+  // thread instead of the caller.
+  inline void SetDeferredFormatting(bool enable) { _deferred = enable; }
+
+  // When enabled, every producer thread logs into its own ring, registered
+  // lazily on its first message, instead of the shared queue. The worker
+  // merges the rings back into call order using each message's tick.
+  inline void SetPerThreadBuffers(bool enable) { _perThreadBuffers = enable; }
+
+  // Dropped messages are counted and reported by the worker as a single
+  // warning at most once every LOG_DROP_REPORT_INTERVAL.
+  inline void SetOverflowPolicy(OverflowPolicy policy, uint32 sampleRate = 8) {
+    _sampleRate = sampleRate > 0 ? sampleRate : 1;
+    _overflowPolicy = policy;
+  }
+
+  // Sinks concatenate messages into one buffer each and write it with a
+  // single call once `maxBytes` are pending, or when the queues run dry and
+  // the oldest buffered message is `maxDelay` old.
+  inline void SetBatchLimits(size_t maxBytes,
+                             std::chrono::milliseconds maxDelay = {}) {
+    std::lock_guard lock(_mutex);
+    _batchBytes = maxBytes > 0 ? maxBytes : 1;
+    _batchDelay = maxDelay;
+    for (const auto &entry : *_sinks)
+      entry->sink->SetBatchBytes(_batchBytes);
+  }
+
+  // Safe from any thread. Counters are read while producers keep going, so
+  // they can be slightly out of step with one another.
+  inline LoggerStats Stats() const {
+    StatTotals totals;
+    {
+      std::lock_guard lock(_statsMutex);
+      totals = _retiredStats;
+      totals.Add(_exitingStats);
+      for (const auto &thread : _threadStats)
+        totals.Add(*thread);
+    }
+
+    const float64 nsPerTick = _nsPerTick.load(std::memory_order_relaxed);
+    const auto toNs = [nsPerTick](uint64 ticks) {
+      return std::chrono::nanoseconds(
+          static_cast<int64>(static_cast<float64>(ticks) * nsPerTick));
+    };
+
+    LoggerStats stats{
+        .enqueued = totals.enqueued,
+        .bytes = totals.bytes,
+        .dropped = totals.dropped +
+                   _sinkDropped.load(std::memory_order_relaxed),
+        .written = _written.load(std::memory_order_relaxed),
+        .queueHighWater = _queueHighWater.load(std::memory_order_relaxed),
+        .callTime = toNs(totals.callTicks),
+        .maxCallTime = toNs(totals.maxCallTicks),
+        .maxLatency = std::chrono::nanoseconds(
+            _maxLatencyNs.load(std::memory_order_relaxed)),
+    };
+
+    std::array<uint64, LOG_LATENCY_BUCKETS> latency;
+    for (size_t i = 0; i < LOG_LATENCY_BUCKETS; ++i)
+      latency[i] = _latency[i].load(std::memory_order_relaxed);
+    stats.latencyP50 = std::chrono::nanoseconds(
+        detail::histogramPercentile(latency, 50));
+    stats.latencyP99 = std::chrono::nanoseconds(
+        detail::histogramPercentile(latency, 99));
+    return stats;
+  }
+
+  // Has the worker log a summary of Stats() at Info level at most once per
+  // `interval`; zero turns it off. Reports ride on traffic, so an idle
+  // Logger stays quiet.
+  inline void SetStatsReportInterval(std::chrono::milliseconds interval) {
+    _statsInterval.store(interval, std::memory_order_relaxed);
+  }
+
+  // PROFILE_SCOPE zones are timed and queued only while profiling is on.
+  inline void EnableProfiling(bool enable) {
+    _profiling.store(enable, std::memory_order_relaxed);
+  }
+
+  inline bool IsProfiling() const noexcept {
+    return _profiling.load(std::memory_order_relaxed);
+  }
+
+  // Safe from any thread. Zones still queued are not counted yet.
+  inline std::vector<ZoneStats> ProfileStats() const {
+    return _profiler.Snapshot();
+  }
+
+  inline void ResetProfileStats() { _profiler.Reset(); }
+
+  // Streams every zone that starts from now on to `path` as Chrome
+  // trace-event JSON, until StopTrace() or the Logger goes away. Returns
+  // false if the file cannot be created.
+  inline bool StartTrace(const std::filesystem::path &path) {
+    return _profiler.StartTrace(path);
+  }
+
+  inline void StopTrace() { _profiler.StopTrace(); }
+
+  // Queues a zone that began at tick `begin` and ends now; PROFILE_SCOPE
+  // calls it as its scope exits.
+  inline void RecordZone(const LogSite &zone, uint64 begin,
+                         uint32 depth) noexcept {
+    const detail::ZoneEvent event{
+        .begin = begin, .thread = detail::zoneThreadId(), .depth = depth};
+    pushToQ([&](LogMessage &msg) {
+      msg.site = &zone;
+      msg.codec = &detail::ARG_CODEC<>;
+      msg.stamp = detail::tick();
+      msg.suppressed = 0;
+      msg.toFile = false;
+      msg.toConsole = false;
+      msg.captured = false;
+      msg.kind = LogMessageKind::Zone;
+      detail::PayloadWriter(msg).Write(&event, sizeof(event));
+    });
+  }
+
+  // Registers a sink; the worker starts feeding it with the next message.
+  inline std::shared_ptr<Sink> AddSink(std::shared_ptr<Sink> sink,
+                                       SinkOptions options = {}) {
+    std::lock_guard lock(_mutex);
+    addSinkLocked(sink, options);
+    return sink;
+  }
+
+  inline void RemoveSink(const std::shared_ptr<Sink> &sink) {
+    std::lock_guard lock(_mutex);
+    removeSinkLocked(sink);
+  }
+
+  // The stdout sink registered at startup, e.g. to change its level or to
+  // remove it.
+  inline std::shared_ptr<Sink> DefaultConsoleSink() const {
+    return _consoleSink;
+  }
+
+  // Precision of the timestamps written to the log file.
+  inline void SetTimestampPrecision(TimestampPrecision precision) {
+    _timestampPrecision = precision;
+  }
+
+  inline void SetLogfilePath(const std::filesystem::path &path) {
+    _logPath = path;
+  }
+
+  // Has the log file written from the next EnableFileLogging(true) on keep
+  // a side index for tools/LogReplay, one entry per `interval` records; zero
+  // turns it off.
+  inline void SetFileIndexInterval(uint32 interval) {
+    _fileIndexInterval = interval;
+  }
+
+  inline void EnableFileLogging(bool enable) {
+    std::unique_lock lock(_mutex);
+    if (_fileSink) {
+      removeSinkLocked(_fileSink);
+      _fileSink.reset();
+    }
+
+    if (enable) {
+      auto sink = std::make_shared<FileSink>(_logPath);
+      if (sink->IsOpen() && _fileIndexInterval > 0)
+        sink->EnableIndex(_fileIndexInterval);
+      if (!sink->IsOpen()) {
+        _logToFile.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        static constexpr LogSite site(LogLevel::Error, "Failed to open file",
+                                      std::source_location::current());
+        if (ShouldLog(site.level))
+          Log(site, "Failed to open file");
+        return;
+      }
+      _fileSink = sink;
+      addSinkLocked(std::move(sink), {});
+    }
+    _logToFile.store(enable, std::memory_order_relaxed);
+  }
+
+  // `fmt` only validates the arguments against the site's format string at
+  // compile time; the site itself is what gets queued.
+  template <typename... Args>
+  inline void LogToFile(const LogSite &site, fstring<Args...> fmt,
+                        const Args &...args) noexcept {
+    LogToFile(site, LogSuppressed{}, fmt, args...);
+  }
+
+  template <typename... Args>
+  void Log(const LogSite &site, fstring<Args...> fmt,
+           const Args &...args) noexcept {
+    Log(site, LogSuppressed{}, fmt, args...);
+  }
+
+  // For rate-limited call sites, which report what they skipped.
+  template <typename... Args>
+  inline void LogToFile(const LogSite &site, LogSuppressed suppressed,
+                        fstring<Args...> fmt, const Args &...args) noexcept {
+    (void)fmt;
+    record(site, args...);
+    if (!_logToFile.load(std::memory_order_relaxed)) {
+      static constexpr LogSite warnSite(
+          LogLevel::Warn, "cannot log to file if it was not previously enabled",
+          std::source_location::current());
+      if (ShouldLog(warnSite.level))
+        Log(warnSite, "cannot log to file if it was not previously enabled");
+      return;
+    }
+
+    const LogLevel fileLevel = _fileLevel.load(std::memory_order_relaxed);
+    const bool toFile = site.level >= threshold(site, fileLevel);
+    const bool toConsole =
+        site.level >= threshold(site, _level.load(std::memory_order_relaxed));
+    if (toFile || toConsole)
+      pushToQ([&](LogMessage &msg) {
+        fillMessage(msg, site, toFile, toConsole, args...);
+        msg.suppressed = suppressed.count;
+      });
+    if (site.level == LogLevel::Fatal)
+      DumpFlightRecorder();
+  }
+
+  template <typename... Args>
+  void Log(const LogSite &site, LogSuppressed suppressed, fstring<Args...> fmt,
+           const Args &...args) noexcept {
+    (void)fmt;
+    record(site, args...);
+    if (site.level >= threshold(site, _level.load(std::memory_order_relaxed)))
+      pushToQ([&](LogMessage &msg) {
+        fillMessage(msg, site, false, true, args...);
+        msg.suppressed = suppressed.count;
+      });
+    if (site.level == LogLevel::Fatal)
+      DumpFlightRecorder();
+  }
 
-using AtomicBool = std::atomic<bool>;
+private:
+  // Caller holds _inlineMutex or no worker has run yet.
+  inline void startWorker() {
+    _running = true;
+    _seenWorkerOptions = 0;
+    _state.store(WorkerState::Running, std::memory_order_release);
+    _workerThread = std::thread([this]() {
+      calibrate();
 
-enum class LogLevel {
-  Trace = 0,
-  Debug,
-  Info,
-  Warn,
-  Error,
-  Fatal,
-  Off,
-};
+      LogMessage msg;
+      while (_running.load()) {
+        applyWorkerOptions();
+        sampleQueueDepth();
+        for (uint32 drained = 1; popNext(msg); ++drained) {
+          write(msg);
+          reportDrops(false);
+          if (drained % LOG_QUEUE_DEPTH_SAMPLE_INTERVAL == 0)
+            sampleQueueDepth();
+        }
+        reportDrops(false);
+        reportStats();
 
-struct LogMessage {
-  LogLevel level;
-  std::source_location where;
-  string message;
-  bool toFile;
-};
+        if (_unflushed) {
+          if (std::chrono::steady_clock::now() - _batchStart <
+              _batchDelay.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+          }
+          flushSinks();
+        }
 
-class Logger {
-public:
-  inline static Logger &Self() {
-    static Logger instance;
-    return instance;
+        _signal.Wait([this]() {
+          return hasPending() || !_running.load(std::memory_order_relaxed);
+        });
+      }
+
+      while (popNext(msg))
+        write(msg);
+      reportDrops(true);
+      flushSinks();
+    });
   }
 
-  inline void SetLevel(LogLevel lvl) { _level = lvl; }
+  inline void calibrate() {
+    _clock.Calibrate();
+    _nsPerTick.store(_clock.NsPerTick());
+    if (FlightRecorder *recorder = _recorder.load())
+      recorder->SetNsPerTick(_clock.NsPerTick());
+  }
 
-  inline void SetLogfilePath(const std::filesystem::path &path) {
-    _logPath = path;
+  // Flushes and stops the worker; see Shutdown(). Holds _shutdownMutex.
+  inline bool stopWorker(std::chrono::milliseconds timeout) {
+    const bool flushed = Flush(timeout);
+    _running = false;
+    _signal.Wake();
+    if (!flushed) {
+      _state.store(WorkerState::Abandoned, std::memory_order_release);
+      return false;
+    }
+
+    _workerThread.join();
+    std::lock_guard lock(_inlineMutex);
+    _state.store(WorkerState::Stopped, std::memory_order_release);
+    drainQueues();
+    return true;
   }
 
-  inline void EnableFileLogging(bool enable) {
-    if (enable) {
-      _logFile.open(_logPath, std::ios::out | std::ios::app);
-      if (!_logFile.is_open()) {
-        Log(LogLevel::Error, std::source_location::current(),
-            "Failed to open file");
-        _logToFile = false;
+  // Worker only: applies the latest SetWorkerOptions() to itself, and warns
+  // about whatever the platform refused.
+  inline void applyWorkerOptions() {
+    const uint32 version =
+        _workerOptionsVersion.load(std::memory_order_acquire);
+    if (version == _seenWorkerOptions)
+      return;
+    _seenWorkerOptions = version;
+
+    WorkerOptions options;
+    {
+      std::lock_guard lock(_mutex);
+      options = _workerOptions;
+    }
+    static constexpr LogSite site(LogLevel::Warn,
+                                  "logger worker: could not apply {} {}",
+                                  std::source_location::current());
+    const auto warn = [this](std::string_view what, int64 value) {
+      if (site.level < _level.load(std::memory_order_relaxed))
+        return;
+      LogMessage msg;
+      fillMessage(msg, site, _logToFile.load(std::memory_order_relaxed),
+                  true, what, value);
+      write(msg);
+    };
+    if (!options.name.empty() && !detail::setThreadName(options.name))
+      warn("name of length", static_cast<int64>(options.name.size()));
+    if (options.cpu >= 0 && !detail::setThreadAffinity(options.cpu))
+      warn("affinity to cpu", options.cpu);
+    if (!detail::setThreadNiceness(options.niceness))
+      warn("niceness", options.niceness);
+  }
+
+  // Writes the message straight into `msg`, normally its queue slot.
+  template <typename... Args>
+  inline void fillMessage(LogMessage &msg, const LogSite &site, bool logToFile,
+                          bool logToConsole, const Args &...args) noexcept {
+    msg.site = &site;
+    msg.codec = &detail::ARG_CODEC<Args...>;
+    msg.stamp = detail::tick();
+    msg.suppressed = 0;
+    msg.toFile = logToFile;
+    msg.toConsole = logToConsole;
+    msg.kind = LogMessageKind::Record;
+
+    // Structured sites always keep their values typed for the sinks.
+    detail::PayloadWriter out(msg);
+    msg.captured = detail::ARE_CAPTURABLE_ARGS<Args...> &&
+                   (site.fields || _deferred.load());
+    if constexpr (detail::ARE_CAPTURABLE_ARGS<Args...>) {
+      if (msg.captured) {
+        (detail::captureArg(out, args), ...);
         return;
       }
-    } else {
-      if (_logFile.is_open())
-        _logFile.close();
     }
-    _logToFile = enable;
+    detail::formatPlanned(site, detail::PayloadOutput{&out}, args...);
   }
 
-  template <typename... Args>
-  inline void LogToFile(LogLevel level, std::source_location where,
-                        std::string_view fmt, const Args &...args) noexcept {
-    if (!_logToFile) {
-      Log(LogLevel::Warn, std::source_location::current(),
-          "cannot log to file if it was not previously enabled");
+  template <typename Fill> inline void pushToQ(Fill &&fill) {
+    // A thread past its thread_locals counts into _exitingStats and logs
+    // through the shared queue.
+    ThreadHandles *handles = threadHandles();
+    detail::ThreadLogStats &stats =
+        handles ? threadStats(*handles) : _exitingStats;
+    const uint64 start = detail::tick();
+    uint32 bytes = 0;
+    auto counted = [&](LogMessage &msg) {
+      fill(msg);
+      bytes = msg.size;
+    };
+
+    if (_state.load(std::memory_order_acquire) != WorkerState::Running)
+        [[unlikely]] {
+      if (!writeInline(counted)) {
+        detail::bump(stats.dropped);
+        return;
+      }
+      detail::bump(stats.enqueued);
+      detail::bump(stats.bytes, bytes);
       return;
     }
 
-    const bool logToFile = true;
-    const string out = format(level, where, fmt, logToFile, args...);
-    LogMessage msg{
-        .level = level,
-        .where = where,
-        .message = out,
-        .toFile = logToFile,
-    };
+    const bool queued =
+        handles && _perThreadBuffers.load(std::memory_order_relaxed)
+            ? enqueue(threadBuffer(*handles).ring, counted, stats)
+            : enqueue(_logQ, counted, stats);
+    if (!queued) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      detail::bump(stats.dropped);
+      return;
+    }
 
-    std::lock_guard lock(_qMutex);
-    pushToQ(msg);
+    _signal.Notify();
+    const uint64 elapsed = detail::tick() - start;
+    detail::bump(stats.enqueued);
+    detail::bump(stats.bytes, bytes);
+    detail::bump(stats.callTicks, elapsed);
+    detail::raise(stats.maxCallTicks, elapsed);
   }
 
   template <typename... Args>
-  void Log(LogLevel level, std::source_location where, std::string_view fmt,
-           const Args &...args) noexcept {
-    if (level < _level)
+  inline void record(const LogSite &site, const Args &...args) noexcept {
+    if (site.level < _recorderLevel.load(std::memory_order_relaxed))
+      return;
+    if (FlightRecorder *recorder = _recorder.load(std::memory_order_acquire))
+      recorder->Record(site, detail::tick(), args...);
+  }
+
+  // Categorised sites answer to their category instead of the Logger.
+  static inline LogLevel threshold(const LogSite &site,
+                                   LogLevel logger) noexcept {
+    return site.category ? site.category->Level() : logger;
+  }
+
+  inline void updateGates() {
+    std::lock_guard lock(_mutex);
+    const LogLevel level = _level.load(std::memory_order_relaxed);
+    const LogLevel recorder = _recorderLevel.load(std::memory_order_relaxed);
+    _gate.store(std::min(level, recorder), std::memory_order_relaxed);
+    _fileGate.store(
+        std::min({level, _fileLevel.load(std::memory_order_relaxed), recorder}),
+        std::memory_order_relaxed);
+  }
+
+  // Returns false when the overflow policy discarded the message, in which
+  // case `fill` never ran.
+  template <typename Ring, typename Fill>
+  inline bool enqueue(Ring &ring, Fill &fill, detail::ThreadLogStats &stats) {
+    switch (_overflowPolicy.load(std::memory_order_relaxed)) {
+    case OverflowPolicy::Block:
+      while (!ring.TryEmplace(fill))
+        std::this_thread::yield();
+      return true;
+    case OverflowPolicy::DropNewest:
+      return ring.TryEmplace(fill);
+    case OverflowPolicy::DropOldest:
+      while (!ring.TryEmplace(fill)) {
+        LogMessage evicted;
+        if (!ring.TryPop(evicted))
+          continue;
+        if (evicted.kind == LogMessageKind::Record) {
+          detail::releasePayload(evicted);
+          _dropped.fetch_add(1, std::memory_order_relaxed);
+          detail::bump(stats.dropped);
+          continue;
+        }
+        // Only records are evicted. A flush marker or zone goes back in
+        // behind the newest message, so a marker still follows everything
+        // logged before it and Flush() is answered.
+        while (!ring.TryEmplace(
+            [&evicted](LogMessage &slot) { slot = std::move(evicted); }))
+          std::this_thread::yield();
+      }
+      return true;
+    case OverflowPolicy::Sample:
+      if (ring.SizeApprox() * 4 >= Ring::CAPACITY * 3 &&
+          _sampleCounter.fetch_add(1, std::memory_order_relaxed) %
+                  _sampleRate.load(std::memory_order_relaxed) !=
+              0)
+        return false;
+      return ring.TryEmplace(fill);
+    }
+    return false;
+  }
+
+  // Worker only. Emits one warning summarising every message dropped since
+  // the last report, unless that report was too recent and `force` is unset.
+  inline void reportDrops(bool force) {
+    if (_dropped.load(std::memory_order_relaxed) == 0)
+      return;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (!force && now - _lastDropReport < LOG_DROP_REPORT_INTERVAL)
+      return;
+
+    _lastDropReport = now;
+    const uint64 dropped = _dropped.exchange(0, std::memory_order_relaxed);
+    static constexpr LogSite site(LogLevel::Warn,
+                                  "dropped {} message(s): a log queue was full",
+                                  std::source_location::current());
+    LogMessage msg;
+    fillMessage(msg, site, _logToFile.load(std::memory_order_relaxed), true,
+                dropped);
+    write(msg);
+  }
+
+  // Worker only. Logs a summary of Stats() once the report interval is up,
+  // with throughput measured since the previous report.
+  inline void reportStats() {
+    const auto interval = _statsInterval.load(std::memory_order_relaxed);
+    if (interval.count() <= 0)
+      return;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (_lastStatsReport == std::chrono::steady_clock::time_point{}) {
+      _lastStatsReport = now; // Starts the first interval.
+      _reportedWritten = _written.load(std::memory_order_relaxed);
+      return;
+    }
+    if (now - _lastStatsReport < interval)
+      return;
+
+    const LoggerStats stats = Stats();
+    const float64 seconds =
+        std::chrono::duration<float64>(now - _lastStatsReport).count();
+    const float64 rate =
+        static_cast<float64>(stats.written - _reportedWritten) / seconds;
+    _lastStatsReport = now;
+    _reportedWritten = stats.written;
+
+    static constexpr LogSite site(
+        LogLevel::Info,
+        "logger: {:.0f} msg/s, {} written, {} dropped, queue high-water {}, "
+        "latency p50 {} us p99 {} us max {} us, {} ns per call",
+        std::source_location::current());
+    if (site.level < _level.load(std::memory_order_relaxed))
       return;
 
-    const bool logToFile = false;
-    const string out = format(level, where, fmt, logToFile, args...);
-    LogMessage msg{
-        .level = level,
-        .where = where,
-        .message = out,
-        .toFile = logToFile,
+    const auto us = [](std::chrono::nanoseconds ns) {
+      return static_cast<uint64>(ns.count() / 1000);
     };
+    const uint64 perCall =
+        stats.enqueued > 0
+            ? static_cast<uint64>(stats.callTime.count()) / stats.enqueued
+            : 0;
+    LogMessage msg;
+    fillMessage(msg, site, _logToFile.load(std::memory_order_relaxed), true,
+                rate, stats.written, stats.dropped, stats.queueHighWater,
+                us(stats.latencyP50), us(stats.latencyP99),
+                us(stats.maxLatency), perCall);
+    write(msg);
+  }
 
-    std::lock_guard lock(_qMutex);
-    pushToQ(msg);
+  // Worker only: records how many messages are waiting, all queues together.
+  inline void sampleQueueDepth() {
+    size_t depth = _logQ.SizeApprox() + _hasSharedStaged;
+    for (const auto &source : _workerBuffers)
+      depth += source.buffer->ring.SizeApprox() + source.hasStaged;
+    if (depth > _queueHighWater.load(std::memory_order_relaxed))
+      _queueHighWater.store(depth, std::memory_order_relaxed);
   }
 
-private:
-  inline Logger() {
-    _workerThread = std::thread([this]() {
-      while (_running.load()) {
-        std::unique_lock lock(_qMutex);
-        _cv.wait(lock, [this]() { return !_logQ.empty() || !_running.load(); });
+  // Worker only: delivery latency of a message handed to the sinks.
+  inline void recordLatency(uint64 stamp) {
+    const uint64 now = detail::tick();
+    const auto ns = static_cast<uint64>(
+        static_cast<float64>(now > stamp ? now - stamp : 0) *
+        _clock.NsPerTick());
+    const size_t bucket = std::min<size_t>(
+        ns > 0 ? std::bit_width(ns) - 1 : 0, LOG_LATENCY_BUCKETS - 1);
+    detail::bump(_latency[bucket]);
+    detail::raise(_maxLatencyNs, ns);
+    detail::bump(_written);
+  }
 
-        while (!_logQ.empty()) {
-          LogMessage msg = std::move(_logQ.front());
-          _logQ.pop();
-          lock.unlock();
+  // The calling thread's registrations with this Logger. Retired when the
+  // thread exits; the Logger folds or frees them from there.
+  struct ThreadHandles {
+    std::shared_ptr<detail::ThreadLogStats> stats;
+    std::shared_ptr<ThreadLogBuffer> buffer;
 
-          if (msg.toFile && _logToFile && _logFile.is_open()) {
-            _logFile << msg.message;
-          }
+    inline ~ThreadHandles() {
+      if (stats)
+        stats->retired.store(true, std::memory_order_release);
+      if (buffer)
+        buffer->retired.store(true, std::memory_order_release);
+    }
+  };
 
-          std::print("{}", msg.message);
-          lock.lock();
-        }
+  // A thread may log into several Loggers: a one-entry cache keeps the
+  // common case to a compare, in front of a map by Logger id. Null once the
+  // thread's thread_locals are gone, e.g. in static destructors, which run
+  // after them on the main thread.
+  inline ThreadHandles *threadHandles() {
+    thread_local bool exited = false; // Trivially destructible: outlives Cache.
+    struct Cache {
+      uint64 id = 0;
+      ThreadHandles *handles = nullptr;
+      fmap<uint64, uptr<ThreadHandles>> all;
+
+      inline ~Cache() { exited = true; }
+    };
+    thread_local Cache cache;
+
+    if (exited) [[unlikely]]
+      return nullptr;
+    if (cache.id == _id) [[likely]]
+      return cache.handles;
+    uptr<ThreadHandles> &handles = cache.all[_id];
+    if (!handles)
+      handles = std::make_unique<ThreadHandles>();
+    cache.id = _id;
+    cache.handles = handles.get();
+    return handles.get();
+  }
+
+  // The calling thread's counters, registered on first use. Exited threads
+  // are folded into _retiredStats whenever a new one registers.
+  inline detail::ThreadLogStats &threadStats(ThreadHandles &handles) {
+    if (!handles.stats) {
+      handles.stats = std::make_shared<detail::ThreadLogStats>();
+      std::lock_guard lock(_statsMutex);
+      std::erase_if(_threadStats, [this](const auto &stats) {
+        if (!stats->retired.load(std::memory_order_acquire))
+          return false;
+        _retiredStats.Add(*stats);
+        return true;
+      });
+      _threadStats.push_back(handles.stats);
+    }
+    return *handles.stats;
+  }
+
+  // Registers the calling thread's ring on first use. It is retired when the
+  // thread exits; the worker reclaims it once drained.
+  inline ThreadLogBuffer &threadBuffer(ThreadHandles &handles) {
+    if (!handles.buffer) {
+      handles.buffer = std::make_shared<ThreadLogBuffer>();
+      std::lock_guard lock(_buffersMutex);
+      _threadBuffers.push_back(handles.buffer);
+      _buffersVersion.fetch_add(1, std::memory_order_release);
+    }
+    return *handles.buffer;
+  }
+
+  // Worker only: picks up buffers registered since the last call and frees
+  // the ones whose thread has exited and which have nothing left to drain.
+  inline void refreshThreadBuffers() {
+    const uint32 version = _buffersVersion.load(std::memory_order_acquire);
+    if (version != _seenBuffersVersion) {
+      std::lock_guard lock(_buffersMutex);
+      for (const auto &buffer : _threadBuffers) {
+        if (std::ranges::find(_workerBuffers, buffer,
+                              &StagedBuffer::buffer) == _workerBuffers.end())
+          _workerBuffers.push_back({.buffer = buffer});
       }
+      _seenBuffersVersion = version;
+    }
+
+    std::erase_if(_workerBuffers, [this](const StagedBuffer &source) {
+      if (source.hasStaged ||
+          !source.buffer->retired.load(std::memory_order_acquire) ||
+          !source.buffer->ring.Empty())
+        return false;
+
+      std::lock_guard lock(_buffersMutex);
+      std::erase(_threadBuffers, source.buffer);
+      return true;
     });
   }
 
-  ~Logger() {
-    _running = false;
-    _cv.notify_all();
-    if (_workerThread.joinable()) {
-      _workerThread.join();
+  inline bool hasPending() {
+    if (_hasSharedStaged || !_logQ.Empty())
+      return true;
+
+    refreshThreadBuffers();
+    for (const auto &source : _workerBuffers) {
+      if (source.hasStaged || !source.buffer->ring.Empty())
+        return true;
+    }
+    return false;
+  }
+
+  // Worker only: pops the oldest message across the shared queue and every
+  // thread's ring. Each source's head is popped into a staging slot first,
+  // since producers evicting under DropOldest make peeking in place unsafe.
+  // Messages still being published may arrive slightly out of order, but
+  // everything visible is emitted in tick order.
+  inline bool popNext(LogMessage &out) {
+    if (_workerBuffers.empty() &&
+        _buffersVersion.load(std::memory_order_relaxed) ==
+            _seenBuffersVersion) {
+      if (!_hasSharedStaged)
+        return _logQ.TryPop(out);
+
+      out = std::move(_sharedStaged);
+      _hasSharedStaged = false;
+      return true;
+    }
+
+    refreshThreadBuffers();
+    if (!_hasSharedStaged)
+      _hasSharedStaged = _logQ.TryPop(_sharedStaged);
+
+    LogMessage *oldest = _hasSharedStaged ? &_sharedStaged : nullptr;
+    bool *oldestStaged = &_hasSharedStaged;
+    for (auto &source : _workerBuffers) {
+      if (!source.hasStaged)
+        source.hasStaged = source.buffer->ring.TryPop(source.staged);
+      if (source.hasStaged &&
+          (!oldest || source.staged.stamp < oldest->stamp)) {
+        oldest = &source.staged;
+        oldestStaged = &source.hasStaged;
+      }
+    }
+
+    if (!oldest)
+      return false;
+
+    out = std::move(*oldest);
+    *oldestStaged = false;
+    return true;
+  }
+
+  inline void addSinkLocked(std::shared_ptr<Sink> sink, SinkOptions options) {
+    sink->SetBatchBytes(_batchBytes);
+    auto entry = std::make_shared<SinkEntry>();
+    entry->sink = sink;
+    if (options.dedicatedThread)
+      entry->worker = std::make_unique<detail::SinkWorker>(std::move(sink));
+
+    auto sinks = std::make_shared<SinkList>(*_sinks);
+    sinks->push_back(std::move(entry));
+    _sinks = std::move(sinks);
+    _sinksVersion.fetch_add(1, std::memory_order_release);
+  }
+
+  inline void removeSinkLocked(const std::shared_ptr<Sink> &sink) {
+    auto sinks = std::make_shared<SinkList>(*_sinks);
+    std::erase_if(*sinks,
+                  [&sink](const auto &entry) { return entry->sink == sink; });
+    _sinks = std::move(sinks);
+    _sinksVersion.fetch_add(1, std::memory_order_release);
+  }
+
+  // Worker only: picks up the current sink list if it changed.
+  inline void refreshSinks() {
+    const uint32 version = _sinksVersion.load(std::memory_order_acquire);
+    if (version == _seenSinksVersion)
+      return;
+
+    std::lock_guard lock(_mutex);
+    _workerSinks = _sinks;
+    _seenSinksVersion = version;
+  }
+
+  // Worker only: finishes formatting the payload, if it was deferred and
+  // some sink needs the text, hands the record to every sink that accepts
+  // it and returns the payload's chunks to the pool.
+  inline void write(LogMessage &msg) {
+    if (msg.kind == LogMessageKind::Zone) {
+      writeZone(msg);
+      return;
+    }
+    if (msg.kind == LogMessageKind::Flush) {
+      completeFlush(msg);
+      return;
+    }
+
+    const std::string_view payload = detail::payloadView(msg, _scratch);
+    LogRecord record{
+        .site = msg.site,
+        .time = _clock.ToWall(msg.stamp),
+        .payload = msg.captured ? std::string_view() : payload,
+        .toFile = msg.toFile,
+        .toConsole = msg.toConsole,
+        .precision = _timestampPrecision.load(std::memory_order_relaxed),
+        .suppressed = msg.suppressed,
+        .codec = msg.codec,
+        .args = msg.captured
+                    ? reinterpret_cast<const std::byte *>(payload.data())
+                    : nullptr,
+        .argBytes = msg.captured ? msg.size : 0,
+    };
+
+    refreshSinks();
+    if (!_unflushed) {
+      _unflushed = true;
+      _batchStart = std::chrono::steady_clock::now();
+    }
+
+    if (msg.captured && needsText(record)) {
+      _text.clear();
+      msg.codec->format(*msg.site, record.args, _text);
+      record.payload = _text;
+    }
+
+    for (const auto &entry : *_workerSinks) {
+      if (!entry->sink->Accepts(record))
+        continue;
+
+      if (!entry->worker) {
+        entry->sink->Write(record);
+      } else if (!entry->worker->Push(record)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        detail::bump(_sinkDropped);
+      }
+    }
+    recordLatency(msg.stamp);
+    detail::releasePayload(msg);
+  }
+
+  // After Shutdown(): the caller does the worker's job, under _inlineMutex,
+  // starting with whatever was queued while the worker stopped. Returns
+  // false if the message was dropped.
+  template <typename Fill> inline bool writeInline(Fill &fill) {
+    std::lock_guard lock(_inlineMutex);
+    if (_state.load(std::memory_order_relaxed) == WorkerState::Abandoned) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
     }
 
-    while (!_logQ.empty()) {
-      auto msg = _logQ.front();
-      _logQ.pop();
-      if (msg.toFile && _logToFile && _logFile.is_open())
-        _logFile << msg.message;
+    drainQueues();
+    LogMessage msg;
+    fill(msg);
+    write(msg);
+    flushSinks();
+    return true;
+  }
+
+  // Worker, or the caller once the worker has stopped.
+  inline void drainQueues() {
+    LogMessage msg;
+    while (popNext(msg))
+      write(msg);
+    reportDrops(true);
+    flushSinks();
+  }
+
+  // Worker only: writes out every sink, waits for the dedicated ones, then
+  // tells Flush() callers up to this marker that they are done.
+  inline void completeFlush(LogMessage &msg) {
+    detail::FlushRequest request;
+    std::memcpy(&request, msg.payload.data(), sizeof(request));
+    detail::releasePayload(msg);
+
+    refreshSinks();
+    _unflushed = false;
+    for (const auto &entry : *_workerSinks) {
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          request.deadline - std::chrono::steady_clock::now());
+      if (!entry->worker)
+        entry->sink->Drain(std::max(left, std::chrono::milliseconds(0)));
       else
-        std::print("{}", msg.message);
+        entry->worker->WaitFlushed(request.deadline);
     }
+    _profiler.Flush();
 
-    if (_logFile.is_open()) {
-      _logFile.close();
+    {
+      std::lock_guard lock(_flushMutex);
+      _flushedSequence = std::max(_flushedSequence, request.sequence);
     }
+    _flushedCv.notify_all();
   }
 
-  Logger(const Logger &) = delete;
-  Logger &operator=(const Logger &) = delete;
+  // Worker only: zones go to the profiler and never reach the sinks.
+  inline void writeZone(LogMessage &msg) {
+    detail::ZoneEvent event;
+    std::memcpy(&event, msg.payload.data(), sizeof(event));
+    const auto ns = static_cast<uint64>(
+        static_cast<float64>(msg.stamp > event.begin ? msg.stamp - event.begin
+                                                     : 0) *
+        _clock.NsPerTick());
+    _profiler.Record(*msg.site, _clock.ToWall(event.begin), ns, event);
 
-  template <typename... Args>
-  inline string format(LogLevel level, std::source_location where,
-                       std::string_view fmt, bool logToFile,
-                       const Args &...args) noexcept {
-    auto payload = std::vformat(fmt, std::make_format_args(args...));
-    const char *color = LevelColour(level);
-    const char *reset = COLOR_RESET.c_str();
-    const char *lvlStr = toString(level);
-    const char *full = where.file_name();
-    const char *p = std::strstr(full, "src/");
-    if (!p) {
-      auto slash = std::strrchr(full, '/');
-      p = slash ? slash + 1 : full;
-    }
-
-    if (logToFile) {
-      const auto now = std::chrono::system_clock::now();
-      std::time_t nowTime = std::chrono::system_clock::to_time_t(now);
-      string nowTimeStr = std::ctime(&nowTime);
-      std::erase(nowTimeStr, '\n');
-      return std::format("[{}] - [{}] {}:{} in function '{}': {}\n", nowTimeStr,
-                         lvlStr, p, where.line(), where.function_name(),
-                         payload);
-    }
-
-    return std::format("{}[{}] {}:{} in function {}'{}'{}: {}{}\n", color,
-                       lvlStr, p, where.line(), reset, where.function_name(),
-                       color, payload, reset);
-  }
-
-  inline void pushToQ(LogMessage msg) {
-    _logQ.push(std::move(msg));
-    _cv.notify_one();
-  }
-
-  inline constexpr const char *toString(LogLevel lvl) const {
-    switch (lvl) {
-    case LogLevel::Trace:
-      return "TRACE";
-    case LogLevel::Debug:
-      return "DEBUG";
-    case LogLevel::Info:
-      return "INFO";
-    case LogLevel::Warn:
-      return "WARN";
-    case LogLevel::Error:
-      return "ERROR";
-    case LogLevel::Fatal:
-      return "FATAL";
-    case LogLevel::Off:
-      return "";
-    }
-
-    // This should never hit
-    return "UNKNOWN";
-  }
-
-  inline constexpr const char *LevelColour(LogLevel lvl) {
-    switch (lvl) {
-    case LogLevel::Trace:
-      return COLOR_GREY.c_str();
-    case LogLevel::Debug:
-      return COLOR_BLUE.c_str();
-    case LogLevel::Info:
-      return COLOR_GREEN.c_str();
-      ;
-    case LogLevel::Warn:
-      return COLOR_YELLOW.c_str();
-    case LogLevel::Error:
-      return COLOR_RED.c_str();
-    case LogLevel::Fatal:
-      return COLOR_FATAL.c_str(); // red bg, white text
-    default:
-      return COLOR_RESET.c_str();
+    if (!_unflushed) {
+      _unflushed = true;
+      _batchStart = std::chrono::steady_clock::now();
+    }
+    recordLatency(msg.stamp);
+    detail::releasePayload(msg);
+  }
+
+  // Sink threads keep at most LOG_ARG_BUFFER_SIZE bytes of raw arguments.
+  inline bool needsText(const LogRecord &record) const {
+    if (!record.codec->portable)
+      return true;
+    for (const auto &entry : *_workerSinks) {
+      if (!entry->sink->Accepts(record))
+        continue;
+      if (entry->sink->NeedsText() ||
+          (entry->worker && record.argBytes > LOG_ARG_BUFFER_SIZE))
+        return true;
+    }
+    return false;
+  }
+
+  // Worker only: sinks on their own thread flush whenever they run dry.
+  inline void flushSinks() {
+    if (!_unflushed)
+      return;
+
+    _unflushed = false;
+    for (const auto &entry : *_workerSinks) {
+      if (!entry->worker)
+        entry->sink->Flush();
     }
+    _profiler.Flush();
   }
 
 private:
+  static inline uint64 nextId() noexcept {
+    static std::atomic<uint64> next = 1;
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const string _name;
+  const uint64 _id = nextId(); // Never reused, unlike addresses.
   const std::filesystem::path DEFAULT_PATH = "./log.txt";
-  std::fstream _logFile;
-  bool _logToFile = false;
+  AtomicBool _logToFile = false;
   std::filesystem::path _logPath = DEFAULT_PATH;
+  uint32 _fileIndexInterval = 0;
   std::mutex _mutex;
-  LogLevel _level = LogLevel::Trace;
+  std::atomic<LogLevel> _level = LogLevel::Trace;
+  std::atomic<LogLevel> _fileLevel = LogLevel::Trace;
+  std::atomic<LogLevel> _gate = LogLevel::Trace; // min(_level, _recorderLevel)
+  std::atomic<LogLevel> _fileGate = LogLevel::Trace; // ... and _fileLevel
+
+  // Flight recorder, created on first use and kept until the Logger dies.
+  std::atomic<LogLevel> _recorderLevel = LogLevel::Off;
+  std::atomic<FlightRecorder *> _recorder = nullptr;
+  uptr<FlightRecorder> _recorderStorage;
+  std::atomic<float64> _nsPerTick = 1.0;
+  AtomicBool _deferred = false;
+  AtomicBool _perThreadBuffers = false;
+  std::atomic<OverflowPolicy> _overflowPolicy = OverflowPolicy::Block;
+  std::atomic<uint32> _sampleRate = 8;
+  std::atomic<uint32> _sampleCounter = 0;
+  std::atomic<uint64> _dropped = 0;
+  std::chrono::steady_clock::time_point _lastDropReport{};
+
+  // Metrics: producer counters live in each thread's ThreadLogStats, the
+  // rest is written by the worker only.
+  struct StatTotals {
+    uint64 enqueued = 0;
+    uint64 bytes = 0;
+    uint64 dropped = 0;
+    uint64 callTicks = 0;
+    uint64 maxCallTicks = 0;
+
+    inline void Add(const detail::ThreadLogStats &thread) {
+      enqueued += thread.enqueued.load(std::memory_order_relaxed);
+      bytes += thread.bytes.load(std::memory_order_relaxed);
+      dropped += thread.dropped.load(std::memory_order_relaxed);
+      callTicks += thread.callTicks.load(std::memory_order_relaxed);
+      maxCallTicks = std::max(
+          maxCallTicks, thread.maxCallTicks.load(std::memory_order_relaxed));
+    }
+  };
+  mutable std::mutex _statsMutex;
+  std::vector<std::shared_ptr<detail::ThreadLogStats>> _threadStats;
+  StatTotals _retiredStats;
+  detail::ThreadLogStats _exitingStats; // Several writers, rarely: best effort.
+  std::atomic<uint64> _written = 0;
+  std::atomic<uint64> _sinkDropped = 0;
+  std::atomic<size_t> _queueHighWater = 0;
+  std::atomic<uint64> _maxLatencyNs = 0;
+  std::array<std::atomic<uint64>, LOG_LATENCY_BUCKETS> _latency{};
+  std::atomic<std::chrono::milliseconds> _statsInterval{};
+  std::chrono::steady_clock::time_point _lastStatsReport{};
+  uint64 _reportedWritten = 0;
+
+  // PROFILE_SCOPE zones, aggregated by the worker.
+  AtomicBool _profiling = false;
+  ZoneProfiler _profiler;
 
   // Async variables
-  std::queue<LogMessage> _logQ;
-  std::mutex _qMutex;
-  std::condition_variable _cv;
+  MpscRing<LogMessage, LOG_QUEUE_CAPACITY> _logQ;
+  WorkerSignal _signal;
   std::thread _workerThread;
   AtomicBool _running = true;
+
+  // Flush() handshake: each caller queues a marker with the next sequence
+  // number and waits until the worker has published it in _flushedSequence.
+  std::atomic<uint64> _flushRequested = 0;
+  std::mutex _flushMutex;
+  std::condition_variable _flushedCv;
+  uint64 _flushedSequence = 0; // Under _flushMutex.
+
+  // Shutdown() and inline mode: once the worker is Stopped, callers write
+  // inline under _inlineMutex; once Abandoned, after a timed-out flush, they
+  // drop.
+  enum class WorkerState : uint8 { Running, Stopped, Abandoned };
+  std::atomic<WorkerState> _state = WorkerState::Running;
+  std::mutex _shutdownMutex;
+  std::mutex _inlineMutex;
+  bool _shutDown = false; // Under _shutdownMutex.
+
+  // SetWorkerOptions(): the options live under _mutex, the worker applies
+  // them whenever the version moves past the one it has seen.
+  WorkerOptions _workerOptions;
+  std::atomic<uint32> _workerOptionsVersion = 1;
+  uint32 _seenWorkerOptions = 0;
+
+  // Per-thread buffers: the registry is shared with producers, the snapshot
+  // belongs to the worker and is refreshed whenever the version changes.
+  std::mutex _buffersMutex;
+  std::vector<std::shared_ptr<ThreadLogBuffer>> _threadBuffers;
+  std::atomic<uint32> _buffersVersion = 0;
+  uint32 _seenBuffersVersion = 0;
+
+  // Worker-side staging: the oldest message already popped from a source,
+  // held back until it is the oldest across all of them.
+  struct StagedBuffer {
+    std::shared_ptr<ThreadLogBuffer> buffer;
+    LogMessage staged{};
+    bool hasStaged = false;
+  };
+  std::vector<StagedBuffer> _workerBuffers;
+  LogMessage _sharedStaged{};
+  bool _hasSharedStaged = false;
+
+  // Sinks: the list is copied on write under _mutex and published through
+  // the version counter; the worker keeps its own snapshot.
+  struct SinkEntry {
+    std::shared_ptr<Sink> sink;
+    uptr<detail::SinkWorker> worker;
+  };
+  using SinkList = std::vector<std::shared_ptr<SinkEntry>>;
+  std::shared_ptr<const SinkList> _sinks = std::make_shared<SinkList>();
+  std::atomic<uint32> _sinksVersion = 0;
+  std::shared_ptr<const SinkList> _workerSinks = _sinks;
+  uint32 _seenSinksVersion = 0;
+  std::shared_ptr<Sink> _consoleSink;
+  std::shared_ptr<Sink> _fileSink;
+
+  // Batching, owned by the worker apart from the limits.
+  bool _unflushed = false;
+  std::chrono::steady_clock::time_point _batchStart{};
+  size_t _batchBytes = LOG_BATCH_BYTES;
+  TickClock _clock;
+  string _scratch; // Worker-owned buffers, reused for every message.
+  string _text;
+  std::atomic<TimestampPrecision> _timestampPrecision =
+      TimestampPrecision::Milliseconds;
+  std::atomic<std::chrono::milliseconds> _batchDelay{};
+};
+
+namespace detail {
+
+// A string literal as a template argument, for LoggerFor.
+template <size_t N> struct LoggerName {
+  inline consteval LoggerName(const char (&name)[N]) {
+    std::copy_n(name, N, chars);
+  }
+
+  inline constexpr std::string_view View() const noexcept {
+    return {chars, N - 1};
+  }
+
+  char chars[N];
+};
+
+} // namespace detail
+
+// Logger::Get(Name), looked up once per name; what the LOG_* macros use
+// with BB_LOG_TAG.
+template <detail::LoggerName Name> inline Logger &LoggerFor() {
+  if constexpr (Name.View().empty()) {
+    return Logger::Self();
+  } else {
+    static Logger &logger = Logger::Get(Name.View());
+    return logger;
+  }
+}
+
+// RAII zone behind PROFILE_SCOPE: takes a tick on entry and, on exit, queues
+// one message with both ticks, the thread and how deeply it is nested. Costs
+// a relaxed load when profiling is off.
+class ProfileScope {
+public:
+  inline ProfileScope(Logger &logger, const LogSite &zone) noexcept {
+    if (!logger.IsProfiling())
+      return;
+    _logger = &logger;
+    _zone = &zone;
+    _depth = depth()++;
+    _begin = detail::tick();
+  }
+
+  inline ~ProfileScope() {
+    if (!_logger)
+      return;
+    --depth();
+    _logger->RecordZone(*_zone, _begin, _depth);
+  }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+  static inline uint32 &depth() noexcept {
+    thread_local uint32 open = 0;
+    return open;
+  }
+
+  Logger *_logger = nullptr;
+  const LogSite *_zone = nullptr;
+  uint64 _begin = 0;
+  uint32 _depth = 0;
 };
 
 } // namespace bb::core
 
+// LogValue types format through their Write(), with or without the Logger,
+// and so do their captures when a deferred message falls back to
+// std::vformat.
+namespace std {
+
+template <typename T>
+  requires bb::core::detail::IS_LOG_VALUE<T>
+struct formatter<T, char> {
+  constexpr auto parse(format_parse_context &ctx) {
+    auto it = ctx.begin();
+    if (it != ctx.end() && *it != '}')
+      throw format_error("log values take no format spec");
+    return it;
+  }
+
+  template <typename Context>
+  auto format(const T &value, Context &ctx) const {
+    bb::core::LogWriter writer;
+    bb::core::LogValue<T>::Write(writer, bb::core::LogValue<T>::Capture(value));
+    const std::string_view text = writer.View();
+    return std::copy(text.begin(), text.end(), ctx.out());
+  }
+};
+
+template <typename T>
+struct formatter<bb::core::detail::CapturedValue<T>, char>
+    : formatter<T, char> {
+  template <typename Context>
+  auto format(const bb::core::detail::CapturedValue<T> &captured,
+              Context &ctx) const {
+    bb::core::LogWriter writer;
+    bb::core::LogValue<T>::Write(writer, captured.value);
+    const std::string_view text = writer.View();
+    return std::copy(text.begin(), text.end(), ctx.out());
+  }
+};
+
+} // namespace std
+
 // —————— macros ——————
-#ifdef NDEBUG
-#define LOG_TRACE(...)                                                         \
-  do {                                                                         \
-  } while (0)
-#define LOG_DEBUG(...)                                                         \
-  do {                                                                         \
-  } while (0)
-#define LOG_INFO(...)                                                          \
-  do {                                                                         \
-  } while (0)
-#define LOG_WARN(...)                                                          \
+// The Logger the macros write to, resolved where they are used: the named
+// Logger BB_LOG_TAG ("net", "render"...), or Self() without one. Define
+// BB_LOG_TAG before including this header to route a whole file, or
+// redefine it in between; define BB_LOG_LOGGER itself to target an
+// injected instance.
+#ifndef BB_LOG_TAG
+#define BB_LOG_TAG ""
+#endif
+
+// Declares a LogCategory at namespace scope, e.g. in the subsystem's header:
+//   BB_LOG_CATEGORY(Net, bb::core::LogLevel::Info);
+// LOG_INFO_C(Net, ...) then logs to it, and Configure("net=trace") or
+// Find("Net") reach it at runtime.
+#define BB_LOG_CATEGORY(name, level)                                           \
+  inline bb::core::LogCategory name(#name, level)
+#ifndef BB_LOG_LOGGER
+#define BB_LOG_LOGGER() bb::core::LoggerFor<BB_LOG_TAG>()
+#endif
+
+#define BB_LOG_NOOP()                                                          \
   do {                                                                         \
   } while (0)
-#define FLOG_TRACE(...)                                                        \
+
+#define BB_LOG_CALL(method, filter, level, fmt, ...)                           \
   do {                                                                         \
+    static constexpr bb::core::LogSite _bbLogSite(                             \
+        level, fmt, std::source_location::current());                          \
+    bb::core::Logger &_bbLogger = BB_LOG_LOGGER();                             \
+    if (_bbLogger.filter(level))                                               \
+      _bbLogger.method(_bbLogSite, fmt, ##__VA_ARGS__);                        \
   } while (0)
-#define FLOG_DEBUG(...)                                                        \
+
+// Like BB_LOG_CALL, but the call site's LogThrottle has to let it through
+// too: `rule(limit, suppressed)` is one of its member functions.
+#define BB_LOG_THROTTLED_CALL(method, filter, level, rule, limit, fmt, ...)    \
   do {                                                                         \
+    static constexpr bb::core::LogSite _bbLogSite(                             \
+        level, fmt, std::source_location::current());                          \
+    static constinit bb::core::LogThrottle _bbLogThrottle;                     \
+    bb::core::Logger &_bbLogger = BB_LOG_LOGGER();                             \
+    bb::core::LogSuppressed _bbSuppressed;                                     \
+    if (_bbLogger.filter(level) &&                                             \
+        _bbLogThrottle.rule(limit, _bbSuppressed))                             \
+      _bbLogger.method(_bbLogSite, _bbSuppressed, fmt, ##__VA_ARGS__);         \
   } while (0)
-#define FLOG_INFO(...)                                                         \
+
+// Structured call sites: `message` then alternating keys and values, e.g.
+// LOG_INFO_KV("spawn", "id", id, "x", x). Keys must be string literals; they
+// live in the site, and only the values are captured. Up to eight fields.
+#define BB_LOG_KV_CALL(method, filter, level, message, ...)                    \
   do {                                                                         \
+    static constexpr std::array<std::string_view,                              \
+                                BB_LOG_KV_NARGS(__VA_ARGS__) / 2>              \
+        _bbLogKeys{BB_LOG_KV_KEYS(__VA_ARGS__)};                               \
+    static constexpr bb::core::LogFields _bbLogFields{                         \
+        message, _bbLogKeys.data(), _bbLogKeys.size()};                        \
+    static constexpr auto _bbLogFormat = bb::core::detail::fieldFormat<        \
+        bb::core::detail::fieldFormatSize(message, _bbLogKeys)>(message,       \
+                                                                _bbLogKeys);   \
+    static constexpr bb::core::LogSite _bbLogSite(                             \
+        level, _bbLogFormat.View(), std::source_location::current(),           \
+        &_bbLogFields);                                                        \
+    bb::core::Logger &_bbLogger = BB_LOG_LOGGER();                             \
+    if (_bbLogger.filter(level))                                               \
+      _bbLogger.method(_bbLogSite, _bbLogFormat.View() __VA_OPT__(, )          \
+                           BB_LOG_KV_VALUES(__VA_ARGS__));                     \
   } while (0)
-#define FLOG_WARN(...)                                                         \
+
+// Like BB_LOG_CALL for a LogCategory, whose level is the only filter.
+#define BB_LOG_CATEGORY_CALL(method, category, level, fmt, ...)                \
   do {                                                                         \
+    static constexpr bb::core::LogSite _bbLogSite(                             \
+        level, fmt, std::source_location::current(), nullptr, &(category));    \
+    if ((category).Enabled(level))                                             \
+      BB_LOG_LOGGER().method(_bbLogSite, fmt, ##__VA_ARGS__);                  \
   } while (0)
-#else
-#define LOG_TRACE(fmt, ...)                                                    \
-  bb::core::Logger::Self().Log(bb::core::LogLevel::Trace,                      \
-                               std::source_location::current(), fmt,           \
-                               ##__VA_ARGS__)
-#define LOG_DEBUG(fmt, ...)                                                    \
-  bb::core::Logger::Self().Log(bb::core::LogLevel::Debug,                      \
-                               std::source_location::current(), fmt,           \
-                               ##__VA_ARGS__)
-#define LOG_INFO(fmt, ...)                                                     \
-  bb::core::Logger::Self().Log(bb::core::LogLevel::Info,                       \
-                               std::source_location::current(), fmt,           \
-                               ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...)                                                     \
-  bb::core::Logger::Self().Log(bb::core::LogLevel::Warn,                       \
-                               std::source_location::current(), fmt,           \
-                               ##__VA_ARGS__)
 
+#define BB_LOG_CAT(a, b) BB_LOG_CAT_IMPL(a, b)
+#define BB_LOG_CAT_IMPL(a, b) a##b
+#define BB_LOG_KV_NARGS(...)                                                   \
+  BB_LOG_KV_PICK(__VA_ARGS__ __VA_OPT__(, ) 16, 15, 14, 13, 12, 11, 10, 9, 8,  \
+                 7, 6, 5, 4, 3, 2, 1, 0)
+#define BB_LOG_KV_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, \
+                       _14, _15, _16, n, ...)                                  \
+  n
+#define BB_LOG_KV_KEYS(...)                                                    \
+  BB_LOG_CAT(BB_LOG_KV_KEYS_, BB_LOG_KV_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define BB_LOG_KV_VALUES(...)                                                  \
+  BB_LOG_CAT(BB_LOG_KV_VALUES_, BB_LOG_KV_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define BB_LOG_KV_KEYS_0()
+#define BB_LOG_KV_VALUES_0()
+#define BB_LOG_KV_KEYS_2(k, v) k
+#define BB_LOG_KV_VALUES_2(k, v) v
+#define BB_LOG_KV_KEYS_4(k, v, ...) k, BB_LOG_KV_KEYS_2(__VA_ARGS__)
+#define BB_LOG_KV_VALUES_4(k, v, ...) v, BB_LOG_KV_VALUES_2(__VA_ARGS__)
+#define BB_LOG_KV_KEYS_6(k, v, ...) k, BB_LOG_KV_KEYS_4(__VA_ARGS__)
+#define BB_LOG_KV_VALUES_6(k, v, ...) v, BB_LOG_KV_VALUES_4(__VA_ARGS__)
+#define BB_LOG_KV_KEYS_8(k, v, ...) k, BB_LOG_KV_KEYS_6(__VA_ARGS__)
+#define BB_LOG_KV_VALUES_8(k, v, ...) v, BB_LOG_KV_VALUES_6(__VA_ARGS__)
+#define BB_LOG_KV_KEYS_10(k, v, ...) k, BB_LOG_KV_KEYS_8(__VA_ARGS__)
+#define BB_LOG_KV_VALUES_10(k, v, ...) v, BB_LOG_KV_VALUES_8(__VA_ARGS__)
+#define BB_LOG_KV_KEYS_12(k, v, ...) k, BB_LOG_KV_KEYS_10(__VA_ARGS__)
+#define BB_LOG_KV_VALUES_12(k, v, ...) v, BB_LOG_KV_VALUES_10(__VA_ARGS__)
+#define BB_LOG_KV_KEYS_14(k, v, ...) k, BB_LOG_KV_KEYS_12(__VA_ARGS__)
+#define BB_LOG_KV_VALUES_14(k, v, ...) v, BB_LOG_KV_VALUES_12(__VA_ARGS__)
+#define BB_LOG_KV_KEYS_16(k, v, ...) k, BB_LOG_KV_KEYS_14(__VA_ARGS__)
+#define BB_LOG_KV_VALUES_16(k, v, ...) v, BB_LOG_KV_VALUES_14(__VA_ARGS__)
+
+#if BB_LOG_ACTIVE_LEVEL <= BB_LOG_LEVEL_TRACE
+#define LOG_TRACE(fmt, ...)                                                    \
+  BB_LOG_CALL(Log, ShouldLog, bb::core::LogLevel::Trace, fmt, ##__VA_ARGS__)
 #define FLOG_TRACE(fmt, ...)                                                   \
-  bb::core::Logger::Self().LogToFile(bb::core::LogLevel::Trace,                \
-                                     std::source_location::current(), fmt,     \
-                                     ##__VA_ARGS__)
+  BB_LOG_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Trace, fmt,      \
+              ##__VA_ARGS__)
+#define LOG_TRACE_EVERY_N(n, fmt, ...)                                         \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Trace,             \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define LOG_TRACE_EVERY_MS(ms, fmt, ...)                                       \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Trace,             \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define LOG_TRACE_ONCE(fmt, ...)                                               \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Trace,             \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define FLOG_TRACE_EVERY_N(n, fmt, ...)                                        \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Trace, \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define FLOG_TRACE_EVERY_MS(ms, fmt, ...)                                      \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Trace, \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define FLOG_TRACE_ONCE(fmt, ...)                                              \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Trace, \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define LOG_TRACE_KV(message, ...)                                             \
+  BB_LOG_KV_CALL(Log, ShouldLog, bb::core::LogLevel::Trace, message,           \
+                 ##__VA_ARGS__)
+#define FLOG_TRACE_KV(message, ...)                                            \
+  BB_LOG_KV_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Trace,        \
+                 message, ##__VA_ARGS__)
+#define LOG_TRACE_C(category, fmt, ...)                                        \
+  BB_LOG_CATEGORY_CALL(Log, category, bb::core::LogLevel::Trace, fmt,          \
+                       ##__VA_ARGS__)
+#define FLOG_TRACE_C(category, fmt, ...)                                       \
+  BB_LOG_CATEGORY_CALL(LogToFile, category, bb::core::LogLevel::Trace, fmt,    \
+                       ##__VA_ARGS__)
+#else
+#define LOG_TRACE(...) BB_LOG_NOOP()
+#define FLOG_TRACE(...) BB_LOG_NOOP()
+#define LOG_TRACE_EVERY_N(...) BB_LOG_NOOP()
+#define LOG_TRACE_EVERY_MS(...) BB_LOG_NOOP()
+#define LOG_TRACE_ONCE(...) BB_LOG_NOOP()
+#define FLOG_TRACE_EVERY_N(...) BB_LOG_NOOP()
+#define FLOG_TRACE_EVERY_MS(...) BB_LOG_NOOP()
+#define FLOG_TRACE_ONCE(...) BB_LOG_NOOP()
+#define LOG_TRACE_KV(...) BB_LOG_NOOP()
+#define FLOG_TRACE_KV(...) BB_LOG_NOOP()
+#define LOG_TRACE_C(...) BB_LOG_NOOP()
+#define FLOG_TRACE_C(...) BB_LOG_NOOP()
+#endif
+
+#if BB_LOG_ACTIVE_LEVEL <= BB_LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...)                                                    \
+  BB_LOG_CALL(Log, ShouldLog, bb::core::LogLevel::Debug, fmt, ##__VA_ARGS__)
 #define FLOG_DEBUG(fmt, ...)                                                   \
-  bb::core::Logger::Self().LogToFile(bb::core::LogLevel::Debug,                \
-                                     std::source_location::current(), fmt,     \
-                                     ##__VA_ARGS__)
+  BB_LOG_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Debug, fmt,      \
+              ##__VA_ARGS__)
+#define LOG_DEBUG_EVERY_N(n, fmt, ...)                                         \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Debug,             \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_EVERY_MS(ms, fmt, ...)                                       \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Debug,             \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_ONCE(fmt, ...)                                               \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Debug,             \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define FLOG_DEBUG_EVERY_N(n, fmt, ...)                                        \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Debug, \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define FLOG_DEBUG_EVERY_MS(ms, fmt, ...)                                      \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Debug, \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define FLOG_DEBUG_ONCE(fmt, ...)                                              \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Debug, \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_KV(message, ...)                                             \
+  BB_LOG_KV_CALL(Log, ShouldLog, bb::core::LogLevel::Debug, message,           \
+                 ##__VA_ARGS__)
+#define FLOG_DEBUG_KV(message, ...)                                            \
+  BB_LOG_KV_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Debug,        \
+                 message, ##__VA_ARGS__)
+#define LOG_DEBUG_C(category, fmt, ...)                                        \
+  BB_LOG_CATEGORY_CALL(Log, category, bb::core::LogLevel::Debug, fmt,          \
+                       ##__VA_ARGS__)
+#define FLOG_DEBUG_C(category, fmt, ...)                                       \
+  BB_LOG_CATEGORY_CALL(LogToFile, category, bb::core::LogLevel::Debug, fmt,    \
+                       ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) BB_LOG_NOOP()
+#define FLOG_DEBUG(...) BB_LOG_NOOP()
+#define LOG_DEBUG_EVERY_N(...) BB_LOG_NOOP()
+#define LOG_DEBUG_EVERY_MS(...) BB_LOG_NOOP()
+#define LOG_DEBUG_ONCE(...) BB_LOG_NOOP()
+#define FLOG_DEBUG_EVERY_N(...) BB_LOG_NOOP()
+#define FLOG_DEBUG_EVERY_MS(...) BB_LOG_NOOP()
+#define FLOG_DEBUG_ONCE(...) BB_LOG_NOOP()
+#define LOG_DEBUG_KV(...) BB_LOG_NOOP()
+#define FLOG_DEBUG_KV(...) BB_LOG_NOOP()
+#define LOG_DEBUG_C(...) BB_LOG_NOOP()
+#define FLOG_DEBUG_C(...) BB_LOG_NOOP()
+#endif
+
+#if BB_LOG_ACTIVE_LEVEL <= BB_LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...)                                                     \
+  BB_LOG_CALL(Log, ShouldLog, bb::core::LogLevel::Info, fmt, ##__VA_ARGS__)
 #define FLOG_INFO(fmt, ...)                                                    \
-  bb::core::Logger::Self().LogToFile(bb::core::LogLevel::Info,                 \
-                                     std::source_location::current(), fmt,     \
-                                     ##__VA_ARGS__)
-#define FLOG_WARN(fmt, ...)                                                    \
-  bb::core::Logger::Self().LogToFile(bb::core::LogLevel::Warn,                 \
-                                     std::source_location::current(), fmt,     \
-                                     ##__VA_ARGS__)
+  BB_LOG_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Info, fmt,      \
+              ##__VA_ARGS__)
+#define LOG_INFO_EVERY_N(n, fmt, ...)                                          \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Info,              \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define LOG_INFO_EVERY_MS(ms, fmt, ...)                                        \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Info,              \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define LOG_INFO_ONCE(fmt, ...)                                                \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Info,              \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define FLOG_INFO_EVERY_N(n, fmt, ...)                                         \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Info,  \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define FLOG_INFO_EVERY_MS(ms, fmt, ...)                                       \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Info,  \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define FLOG_INFO_ONCE(fmt, ...)                                               \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Info,  \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define LOG_INFO_KV(message, ...)                                              \
+  BB_LOG_KV_CALL(Log, ShouldLog, bb::core::LogLevel::Info, message,            \
+                 ##__VA_ARGS__)
+#define FLOG_INFO_KV(message, ...)                                             \
+  BB_LOG_KV_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Info, message,\
+                 ##__VA_ARGS__)
+#define LOG_INFO_C(category, fmt, ...)                                         \
+  BB_LOG_CATEGORY_CALL(Log, category, bb::core::LogLevel::Info, fmt,           \
+                       ##__VA_ARGS__)
+#define FLOG_INFO_C(category, fmt, ...)                                        \
+  BB_LOG_CATEGORY_CALL(LogToFile, category, bb::core::LogLevel::Info, fmt,     \
+                       ##__VA_ARGS__)
+#else
+#define LOG_INFO(...) BB_LOG_NOOP()
+#define FLOG_INFO(...) BB_LOG_NOOP()
+#define LOG_INFO_EVERY_N(...) BB_LOG_NOOP()
+#define LOG_INFO_EVERY_MS(...) BB_LOG_NOOP()
+#define LOG_INFO_ONCE(...) BB_LOG_NOOP()
+#define FLOG_INFO_EVERY_N(...) BB_LOG_NOOP()
+#define FLOG_INFO_EVERY_MS(...) BB_LOG_NOOP()
+#define FLOG_INFO_ONCE(...) BB_LOG_NOOP()
+#define LOG_INFO_KV(...) BB_LOG_NOOP()
+#define FLOG_INFO_KV(...) BB_LOG_NOOP()
+#define LOG_INFO_C(...) BB_LOG_NOOP()
+#define FLOG_INFO_C(...) BB_LOG_NOOP()
+#endif
 
+#if BB_LOG_ACTIVE_LEVEL <= BB_LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...)                                                     \
+  BB_LOG_CALL(Log, ShouldLog, bb::core::LogLevel::Warn, fmt, ##__VA_ARGS__)
+#define FLOG_WARN(fmt, ...)                                                    \
+  BB_LOG_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Warn, fmt,      \
+              ##__VA_ARGS__)
+#define LOG_WARN_EVERY_N(n, fmt, ...)                                          \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Warn,              \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define LOG_WARN_EVERY_MS(ms, fmt, ...)                                        \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Warn,              \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define LOG_WARN_ONCE(fmt, ...)                                                \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Warn,              \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define FLOG_WARN_EVERY_N(n, fmt, ...)                                         \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Warn,  \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define FLOG_WARN_EVERY_MS(ms, fmt, ...)                                       \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Warn,  \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define FLOG_WARN_ONCE(fmt, ...)                                               \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Warn,  \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define LOG_WARN_KV(message, ...)                                              \
+  BB_LOG_KV_CALL(Log, ShouldLog, bb::core::LogLevel::Warn, message,            \
+                 ##__VA_ARGS__)
+#define FLOG_WARN_KV(message, ...)                                             \
+  BB_LOG_KV_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Warn, message,\
+                 ##__VA_ARGS__)
+#define LOG_WARN_C(category, fmt, ...)                                         \
+  BB_LOG_CATEGORY_CALL(Log, category, bb::core::LogLevel::Warn, fmt,           \
+                       ##__VA_ARGS__)
+#define FLOG_WARN_C(category, fmt, ...)                                        \
+  BB_LOG_CATEGORY_CALL(LogToFile, category, bb::core::LogLevel::Warn, fmt,     \
+                       ##__VA_ARGS__)
+#else
+#define LOG_WARN(...) BB_LOG_NOOP()
+#define FLOG_WARN(...) BB_LOG_NOOP()
+#define LOG_WARN_EVERY_N(...) BB_LOG_NOOP()
+#define LOG_WARN_EVERY_MS(...) BB_LOG_NOOP()
+#define LOG_WARN_ONCE(...) BB_LOG_NOOP()
+#define FLOG_WARN_EVERY_N(...) BB_LOG_NOOP()
+#define FLOG_WARN_EVERY_MS(...) BB_LOG_NOOP()
+#define FLOG_WARN_ONCE(...) BB_LOG_NOOP()
+#define LOG_WARN_KV(...) BB_LOG_NOOP()
+#define FLOG_WARN_KV(...) BB_LOG_NOOP()
+#define LOG_WARN_C(...) BB_LOG_NOOP()
+#define FLOG_WARN_C(...) BB_LOG_NOOP()
 #endif
 
+#if BB_LOG_ACTIVE_LEVEL <= BB_LOG_LEVEL_ERROR
 #define LOG_ERROR(fmt, ...)                                                    \
-  bb::core::Logger::Self().Log(bb::core::LogLevel::Error,                      \
-                               std::source_location::current(), fmt,           \
-                               ##__VA_ARGS__)
-#define LOG_FATAL(fmt, ...)                                                    \
-  bb::core::Logger::Self().Log(bb::core::LogLevel::Fatal,                      \
-                               std::source_location::current(), fmt,           \
-                               ##__VA_ARGS__)
-
+  BB_LOG_CALL(Log, ShouldLog, bb::core::LogLevel::Error, fmt, ##__VA_ARGS__)
 #define FLOG_ERROR(fmt, ...)                                                   \
-  bb::core::Logger::Self().LogToFile(bb::core::LogLevel::Error,                \
-                                     std::source_location::current(), fmt,     \
-                                     ##__VA_ARGS__)
+  BB_LOG_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Error, fmt,      \
+              ##__VA_ARGS__)
+#define LOG_ERROR_EVERY_N(n, fmt, ...)                                         \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Error,             \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_EVERY_MS(ms, fmt, ...)                                       \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Error,             \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_ONCE(fmt, ...)                                               \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Error,             \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define FLOG_ERROR_EVERY_N(n, fmt, ...)                                        \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Error, \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define FLOG_ERROR_EVERY_MS(ms, fmt, ...)                                      \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Error, \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define FLOG_ERROR_ONCE(fmt, ...)                                              \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Error, \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_KV(message, ...)                                             \
+  BB_LOG_KV_CALL(Log, ShouldLog, bb::core::LogLevel::Error, message,           \
+                 ##__VA_ARGS__)
+#define FLOG_ERROR_KV(message, ...)                                            \
+  BB_LOG_KV_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Error,        \
+                 message, ##__VA_ARGS__)
+#define LOG_ERROR_C(category, fmt, ...)                                        \
+  BB_LOG_CATEGORY_CALL(Log, category, bb::core::LogLevel::Error, fmt,          \
+                       ##__VA_ARGS__)
+#define FLOG_ERROR_C(category, fmt, ...)                                       \
+  BB_LOG_CATEGORY_CALL(LogToFile, category, bb::core::LogLevel::Error, fmt,    \
+                       ##__VA_ARGS__)
+#else
+#define LOG_ERROR(...) BB_LOG_NOOP()
+#define FLOG_ERROR(...) BB_LOG_NOOP()
+#define LOG_ERROR_EVERY_N(...) BB_LOG_NOOP()
+#define LOG_ERROR_EVERY_MS(...) BB_LOG_NOOP()
+#define LOG_ERROR_ONCE(...) BB_LOG_NOOP()
+#define FLOG_ERROR_EVERY_N(...) BB_LOG_NOOP()
+#define FLOG_ERROR_EVERY_MS(...) BB_LOG_NOOP()
+#define FLOG_ERROR_ONCE(...) BB_LOG_NOOP()
+#define LOG_ERROR_KV(...) BB_LOG_NOOP()
+#define FLOG_ERROR_KV(...) BB_LOG_NOOP()
+#define LOG_ERROR_C(...) BB_LOG_NOOP()
+#define FLOG_ERROR_C(...) BB_LOG_NOOP()
+#endif
+
+#if BB_LOG_ACTIVE_LEVEL <= BB_LOG_LEVEL_FATAL
+#define LOG_FATAL(fmt, ...)                                                    \
+  BB_LOG_CALL(Log, ShouldLog, bb::core::LogLevel::Fatal, fmt, ##__VA_ARGS__)
 #define FLOG_FATAL(fmt, ...)                                                   \
-  bb::core::Logger::Self().LogToFile(bb::core::LogLevel::Fatal,                \
-                                     std::source_location::current(), fmt,     \
-                                     ##__VA_ARGS__)
+  BB_LOG_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Fatal, fmt,      \
+              ##__VA_ARGS__)
+#define LOG_FATAL_EVERY_N(n, fmt, ...)                                         \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Fatal,             \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define LOG_FATAL_EVERY_MS(ms, fmt, ...)                                       \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Fatal,             \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define LOG_FATAL_ONCE(fmt, ...)                                               \
+  BB_LOG_THROTTLED_CALL(Log, ShouldLog, bb::core::LogLevel::Fatal,             \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define FLOG_FATAL_EVERY_N(n, fmt, ...)                                        \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Fatal, \
+                        EveryN, n, fmt, ##__VA_ARGS__)
+#define FLOG_FATAL_EVERY_MS(ms, fmt, ...)                                      \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Fatal, \
+                        EveryMs, ms, fmt, ##__VA_ARGS__)
+#define FLOG_FATAL_ONCE(fmt, ...)                                              \
+  BB_LOG_THROTTLED_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Fatal, \
+                        First, 1, fmt, ##__VA_ARGS__)
+#define LOG_FATAL_KV(message, ...)                                             \
+  BB_LOG_KV_CALL(Log, ShouldLog, bb::core::LogLevel::Fatal, message,           \
+                 ##__VA_ARGS__)
+#define FLOG_FATAL_KV(message, ...)                                            \
+  BB_LOG_KV_CALL(LogToFile, ShouldLogToFile, bb::core::LogLevel::Fatal,        \
+                 message, ##__VA_ARGS__)
+#define LOG_FATAL_C(category, fmt, ...)                                        \
+  BB_LOG_CATEGORY_CALL(Log, category, bb::core::LogLevel::Fatal, fmt,          \
+                       ##__VA_ARGS__)
+#define FLOG_FATAL_C(category, fmt, ...)                                       \
+  BB_LOG_CATEGORY_CALL(LogToFile, category, bb::core::LogLevel::Fatal, fmt,    \
+                       ##__VA_ARGS__)
+#else
+#define LOG_FATAL(...) BB_LOG_NOOP()
+#define FLOG_FATAL(...) BB_LOG_NOOP()
+#define LOG_FATAL_EVERY_N(...) BB_LOG_NOOP()
+#define LOG_FATAL_EVERY_MS(...) BB_LOG_NOOP()
+#define LOG_FATAL_ONCE(...) BB_LOG_NOOP()
+#define FLOG_FATAL_EVERY_N(...) BB_LOG_NOOP()
+#define FLOG_FATAL_EVERY_MS(...) BB_LOG_NOOP()
+#define FLOG_FATAL_ONCE(...) BB_LOG_NOOP()
+#define LOG_FATAL_KV(...) BB_LOG_NOOP()
+#define FLOG_FATAL_KV(...) BB_LOG_NOOP()
+#define LOG_FATAL_C(...) BB_LOG_NOOP()
+#define FLOG_FATAL_C(...) BB_LOG_NOOP()
+#endif
+
+// Times the rest of the enclosing scope as a zone named `name`, a string
+// literal; see Logger::EnableProfiling. Defining BB_PROFILE_DISABLED
+// compiles zones out.
+#ifndef BB_PROFILE_DISABLED
+#define PROFILE_SCOPE(name)                                                    \
+  static constexpr bb::core::LogSite BB_LOG_CAT(_bbZoneSite, __LINE__)(        \
+      bb::core::LogLevel::Trace, name, std::source_location::current());       \
+  const bb::core::ProfileScope BB_LOG_CAT(_bbZone, __LINE__)(                  \
+      BB_LOG_LOGGER(), BB_LOG_CAT(_bbZoneSite, __LINE__))
+#else
+#define PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
 
-#define ENABLE_FILE_LOGGING(enable)                                            \
-  bb::core::Logger::Self().EnableFileLogging(enable);
+#define ENABLE_FILE_LOGGING(enable) BB_LOG_LOGGER().EnableFileLogging(enable);
 
-#define SET_LOG_FILE(filepath)                                                 \
-  bb::core::Logger::Self().SetLogfilePath(filepath);
+#define SET_LOG_FILE(filepath) BB_LOG_LOGGER().SetLogfilePath(filepath);
 
 #endif // _GENERIC_LOGGER_HPP
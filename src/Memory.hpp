@@ -0,0 +1,254 @@
+#ifndef _GENERIC_MEMORY_HPP
+#define _GENERIC_MEMORY_HPP
+
+#include "Defines.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace bb::core {
+
+namespace detail {
+
+inline constexpr size_t alignUp(size_t value, size_t alignment) noexcept {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Offset of the first address at or after `data + offset` that is aligned.
+inline size_t alignedOffset(const std::byte *data, size_t offset,
+                            size_t alignment) noexcept {
+  const auto base = reinterpret_cast<uintptr_t>(data);
+  return alignUp(base + offset, alignment) - base;
+}
+
+} // namespace detail
+
+// Bump allocator for short-lived data, e.g. everything built during a frame.
+// Allocations are O(1) and individually free; Reset() reclaims them all at
+// once and keeps the blocks for the next round. Not thread-safe.
+class LinearArena : public std::pmr::memory_resource {
+public:
+  inline explicit LinearArena(
+      size_t blockSize = 64 * 1024,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : _blockSize(blockSize > 0 ? blockSize : 1), _upstream(upstream) {}
+
+  inline ~LinearArena() override {
+    for (const Block &block : _blocks)
+      _upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+  }
+
+  LinearArena(const LinearArena &) = delete;
+  LinearArena &operator=(const LinearArena &) = delete;
+
+  inline void *Allocate(size_t size,
+                        size_t alignment = alignof(std::max_align_t)) {
+    while (_current < _blocks.size()) {
+      Block &block = _blocks[_current];
+      const size_t offset =
+          detail::alignedOffset(block.data, _offset, alignment);
+      if (offset + size <= block.size) {
+        _offset = offset + size;
+        return block.data + offset;
+      }
+      ++_current;
+      _offset = 0;
+    }
+
+    // Oversized requests get a block of their own.
+    const size_t blockSize = std::max(_blockSize, size + alignment);
+    auto *data = static_cast<std::byte *>(
+        _upstream->allocate(blockSize, alignof(std::max_align_t)));
+    _blocks.push_back({data, blockSize});
+    _current = _blocks.size() - 1;
+
+    const size_t offset = detail::alignedOffset(data, 0, alignment);
+    _offset = offset + size;
+    return data + offset;
+  }
+
+  template <typename T, typename... Args> inline T *New(Args &&...args) {
+    return ::new (Allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  // Frees everything at once. Destructors are not run; use arena_uptr for
+  // objects that need them.
+  inline void Reset() noexcept {
+    _current = 0;
+    _offset = 0;
+  }
+
+  // Bytes handed out since the last Reset(), alignment padding included.
+  inline size_t Used() const noexcept {
+    size_t used = _offset;
+    for (size_t i = 0; i < _current && i < _blocks.size(); ++i)
+      used += _blocks[i].size;
+    return used;
+  }
+
+  inline size_t Capacity() const noexcept {
+    size_t capacity = 0;
+    for (const Block &block : _blocks)
+      capacity += block.size;
+    return capacity;
+  }
+
+protected:
+  inline void *do_allocate(size_t size, size_t alignment) override {
+    return Allocate(size, alignment);
+  }
+
+  inline void do_deallocate(void *, size_t, size_t) override {}
+
+  inline bool
+  do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  struct Block {
+    std::byte *data;
+    size_t size;
+  };
+
+  size_t _blockSize;
+  std::pmr::memory_resource *_upstream;
+  std::vector<Block> _blocks;
+  size_t _current = 0;
+  size_t _offset = 0;
+};
+
+// Runs the destructor only; the arena owns the memory.
+struct ArenaDeleter {
+  template <typename T> inline void operator()(T *object) const noexcept {
+    object->~T();
+  }
+};
+
+template <typename T> using arena_uptr = std::unique_ptr<T, ArenaDeleter>;
+
+template <typename T, typename... Args>
+inline arena_uptr<T> MakeArenaUnique(LinearArena &arena, Args &&...args) {
+  return arena_uptr<T>(arena.New<T>(std::forward<Args>(args)...));
+}
+
+// Hands out fixed-size blocks from slabs, recycling released ones through an
+// intrusive free list. Requests larger than the block size go upstream.
+// Not thread-safe.
+class FixedBlockPool : public std::pmr::memory_resource {
+public:
+  inline FixedBlockPool(
+      size_t blockSize, size_t blocksPerSlab = 64,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : _blockSize(detail::alignUp(std::max(blockSize, sizeof(FreeBlock)),
+                                   alignof(std::max_align_t))),
+        _blocksPerSlab(blocksPerSlab > 0 ? blocksPerSlab : 1),
+        _upstream(upstream) {}
+
+  inline ~FixedBlockPool() override {
+    for (std::byte *slab : _slabs)
+      _upstream->deallocate(slab, _blockSize * _blocksPerSlab,
+                            alignof(std::max_align_t));
+  }
+
+  FixedBlockPool(const FixedBlockPool &) = delete;
+  FixedBlockPool &operator=(const FixedBlockPool &) = delete;
+
+  inline size_t BlockSize() const noexcept { return _blockSize; }
+
+  inline void *Acquire() {
+    if (!_free)
+      grow();
+
+    FreeBlock *block = _free;
+    _free = block->next;
+    return block;
+  }
+
+  inline void Release(void *block) noexcept {
+    auto *freed = static_cast<FreeBlock *>(block);
+    freed->next = _free;
+    _free = freed;
+  }
+
+protected:
+  inline void *do_allocate(size_t size, size_t alignment) override {
+    if (size > _blockSize || alignment > alignof(std::max_align_t))
+      return _upstream->allocate(size, alignment);
+    return Acquire();
+  }
+
+  inline void do_deallocate(void *block, size_t size,
+                            size_t alignment) override {
+    if (size > _blockSize || alignment > alignof(std::max_align_t))
+      _upstream->deallocate(block, size, alignment);
+    else
+      Release(block);
+  }
+
+  inline bool
+  do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  inline void grow() {
+    auto *slab = static_cast<std::byte *>(_upstream->allocate(
+        _blockSize * _blocksPerSlab, alignof(std::max_align_t)));
+    _slabs.push_back(slab);
+    for (size_t i = _blocksPerSlab; i > 0; --i)
+      Release(slab + (i - 1) * _blockSize);
+  }
+
+  size_t _blockSize;
+  size_t _blocksPerSlab;
+  std::pmr::memory_resource *_upstream;
+  std::vector<std::byte *> _slabs;
+  FreeBlock *_free = nullptr;
+};
+
+// Typed front end over FixedBlockPool. Not thread-safe.
+template <typename T> class ObjectPool {
+public:
+  inline explicit ObjectPool(
+      size_t objectsPerSlab = 64,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : _blocks(sizeof(T), objectsPerSlab, upstream) {
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "ObjectPool does not support over-aligned types");
+  }
+
+  template <typename... Args> inline T *Create(Args &&...args) {
+    void *block = _blocks.Acquire();
+    try {
+      return ::new (block) T(std::forward<Args>(args)...);
+    } catch (...) {
+      _blocks.Release(block);
+      throw;
+    }
+  }
+
+  inline void Destroy(T *object) noexcept {
+    if (!object)
+      return;
+    object->~T();
+    _blocks.Release(object);
+  }
+
+private:
+  FixedBlockPool _blocks;
+};
+
+} // namespace bb::core
+
+#endif // _GENERIC_MEMORY_HPP
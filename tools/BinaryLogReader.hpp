@@ -0,0 +1,368 @@
+// Reads the binary log layout (see BinaryLogRecord) written by
+// BinaryFileSink and the flight recorder, for the tools in this directory.
+
+#ifndef _GENERIC_BINARY_LOG_READER_HPP
+#define _GENERIC_BINARY_LOG_READER_HPP
+
+#include "../src/LogSinks.hpp"
+
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace bb::core::tools {
+
+// Above the call site count of any program, so a corrupt site id cannot
+// blow up the site table.
+inline constexpr uint32 MAX_SITE_ID = 1u << 20;
+
+struct Site {
+  LogLevel level = LogLevel::Info;
+  uint32 line = 0;
+  std::string_view fmt;
+  std::string_view file;
+  std::string_view function;
+  std::string_view category; // Empty before version 2 and without one.
+  std::vector<LogArgType> types;
+};
+
+using Value = std::variant<bool, char, int64, uint64, float32, float64,
+                           std::string_view>;
+
+class Reader {
+public:
+  inline explicit Reader(std::string_view data)
+      : _pos(data.data()), _end(data.data() + data.size()) {}
+
+  inline bool AtEnd() const noexcept { return _pos == _end; }
+
+  template <typename T> inline bool Read(T &value) {
+    if (static_cast<size_t>(_end - _pos) < sizeof(T))
+      return false;
+    std::memcpy(&value, _pos, sizeof(T));
+    _pos += sizeof(T);
+    return true;
+  }
+
+  inline bool ReadBytes(std::string_view &out, size_t size) {
+    if (static_cast<size_t>(_end - _pos) < size)
+      return false;
+    out = {_pos, size};
+    _pos += size;
+    return true;
+  }
+
+  inline bool ReadString(std::string_view &out) {
+    uint32 size;
+    return Read(size) && ReadBytes(out, size);
+  }
+
+private:
+  const char *_pos;
+  const char *_end;
+};
+
+template <typename Stored, typename As>
+inline bool readValue(Reader &in, std::vector<Value> &out) {
+  Stored value;
+  if (!in.Read(value))
+    return false;
+  out.emplace_back(static_cast<As>(value));
+  return true;
+}
+
+inline bool readArgs(std::string_view payload, const Site &site,
+                     std::vector<Value> &out) {
+  Reader in(payload);
+  for (const LogArgType type : site.types) {
+    bool ok = false;
+    switch (type) {
+    case LogArgType::Bool:
+      ok = readValue<bool, bool>(in, out);
+      break;
+    case LogArgType::Char:
+      ok = readValue<char, char>(in, out);
+      break;
+    case LogArgType::Int8:
+      ok = readValue<int8, int64>(in, out);
+      break;
+    case LogArgType::Int16:
+      ok = readValue<int16, int64>(in, out);
+      break;
+    case LogArgType::Int32:
+      ok = readValue<int32, int64>(in, out);
+      break;
+    case LogArgType::Int64:
+      ok = readValue<int64, int64>(in, out);
+      break;
+    case LogArgType::UInt8:
+      ok = readValue<uint8, uint64>(in, out);
+      break;
+    case LogArgType::UInt16:
+      ok = readValue<uint16, uint64>(in, out);
+      break;
+    case LogArgType::UInt32:
+      ok = readValue<uint32, uint64>(in, out);
+      break;
+    case LogArgType::UInt64:
+      ok = readValue<uint64, uint64>(in, out);
+      break;
+    case LogArgType::Float32:
+      ok = readValue<float32, float32>(in, out);
+      break;
+    case LogArgType::Float64:
+      ok = readValue<float64, float64>(in, out);
+      break;
+    case LogArgType::String: {
+      std::string_view str;
+      ok = in.ReadString(str);
+      if (ok)
+        out.emplace_back(str);
+      break;
+    }
+    case LogArgType::Opaque:
+      break;
+    }
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+inline bool parseIndex(std::string_view id, size_t &next, size_t &index) {
+  if (id.empty()) {
+    index = next++;
+    return true;
+  }
+
+  index = 0;
+  for (const char c : id) {
+    if (c < '0' || c > '9')
+      return false;
+    index = index * 10 + static_cast<size_t>(c - '0');
+  }
+  return true;
+}
+
+// Dynamic width or precision arguments become literal numbers in the spec.
+inline bool resolveSpec(std::string_view spec, size_t &next,
+                        const std::vector<Value> &args, string &out) {
+  for (size_t i = 0; i < spec.size(); ++i) {
+    if (spec[i] != '{') {
+      out += spec[i];
+      continue;
+    }
+
+    const size_t close = spec.find('}', i);
+    size_t index;
+    if (close == std::string_view::npos ||
+        !parseIndex(spec.substr(i + 1, close - i - 1), next, index) ||
+        index >= args.size())
+      return false;
+
+    const bool integral = std::visit(
+        [&out](const auto &value) {
+          using T = std::decay_t<decltype(value)>;
+          if constexpr (std::is_same_v<T, int64> || std::is_same_v<T, uint64>) {
+            out += std::to_string(value);
+            return true;
+          }
+          return false;
+        },
+        args[index]);
+    if (!integral)
+      return false;
+    i = close;
+  }
+  return true;
+}
+
+// Replays std::format one replacement field at a time, since the argument
+// types are only known at run time here.
+inline void renderMessage(std::string_view fmt, const std::vector<Value> &args,
+                          string &out) {
+  size_t next = 0;
+  for (size_t i = 0; i < fmt.size(); ++i) {
+    const char c = fmt[i];
+    if ((c == '{' || c == '}') && i + 1 < fmt.size() && fmt[i + 1] == c) {
+      out += c;
+      ++i;
+      continue;
+    }
+    if (c != '{') {
+      out += c;
+      continue;
+    }
+
+    // Find the matching close brace, skipping nested dynamic-spec fields.
+    size_t close = i + 1;
+    for (int depth = 1; close < fmt.size(); ++close) {
+      if (fmt[close] == '{')
+        ++depth;
+      else if (fmt[close] == '}' && --depth == 0)
+        break;
+    }
+    const std::string_view field = fmt.substr(i + 1, close - i - 1);
+    i = close;
+
+    const size_t colon = field.find(':');
+    size_t index;
+    string spec;
+    if (!parseIndex(field.substr(0, colon), next, index) ||
+        index >= args.size() ||
+        (colon != std::string_view::npos &&
+         !resolveSpec(field.substr(colon + 1), next, args, spec))) {
+      out += "{?}";
+      continue;
+    }
+
+    try {
+      const string single = "{:" + spec + "}";
+      std::visit(
+          [&](const auto &value) {
+            std::vformat_to(std::back_inserter(out), single,
+                            std::make_format_args(value));
+          },
+          args[index]);
+    } catch (const std::format_error &) {
+      out += "{?}";
+    }
+  }
+}
+
+// One message record, pointing into the log's data.
+struct BinaryLogMessage {
+  const Site *site = nullptr;
+  int64 nanos = 0; // Since the epoch.
+  uint8 flags = 0;
+  uint32 suppressed = 0;
+  std::string_view payload;
+};
+
+// Steps through a binary log's messages, taking in the sessions and call
+// sites on the way.
+class BinaryLogReader {
+public:
+  inline explicit BinaryLogReader(std::string_view data) : _in(data) {}
+
+  // False at the end of the data, or on a malformed record (see Error()).
+  inline bool Next(BinaryLogMessage &msg) {
+    while (!_in.AtEnd()) {
+      BinaryLogRecord kind;
+      _in.Read(kind);
+
+      switch (kind) {
+      case BinaryLogRecord::Session: {
+        std::string_view magic;
+        if (!_in.ReadBytes(magic, LOG_BINARY_MAGIC.size()) ||
+            magic != LOG_BINARY_MAGIC || !_in.Read(_version))
+          return fail("not a binary log file");
+        if (_version == 0 || _version > LOG_BINARY_VERSION)
+          return fail("unsupported binary log version");
+        _sites.clear();
+        break;
+      }
+
+      case BinaryLogRecord::Site: {
+        uint32 id;
+        uint8 level;
+        uint8 count;
+        Site site;
+        if (!_in.Read(id) || !_in.Read(level) || !_in.Read(site.line) ||
+            !_in.ReadString(site.fmt) || !_in.ReadString(site.file) ||
+            !_in.ReadString(site.function) || !_in.Read(count))
+          return fail("truncated call site record");
+
+        site.level = static_cast<LogLevel>(level);
+        site.types.resize(count);
+        for (LogArgType &type : site.types) {
+          if (!_in.Read(type))
+            return fail("truncated call site record");
+        }
+        if (_version >= 2 && !_in.ReadString(site.category))
+          return fail("truncated call site record");
+        if (id > MAX_SITE_ID)
+          return fail("call site id out of range");
+        if (id >= _sites.size())
+          _sites.resize(id + 1);
+        _sites[id] = std::move(site);
+        break;
+      }
+
+      case BinaryLogRecord::Message: {
+        uint32 id;
+        msg.suppressed = 0;
+        if (!_in.Read(id) || !_in.Read(msg.nanos) || !_in.Read(msg.flags) ||
+            ((msg.flags & LOG_BINARY_SUPPRESSED) &&
+             !_in.Read(msg.suppressed)) ||
+            !_in.ReadString(msg.payload))
+          return fail("truncated message record");
+        if (id >= _sites.size())
+          return fail("message refers to an unknown call site");
+        msg.site = &_sites[id];
+        return true;
+      }
+
+      default:
+        return fail("unknown record kind");
+      }
+    }
+    return false;
+  }
+
+  // Why Next() stopped early; null at the end of the data.
+  inline const char *Error() const noexcept { return _error; }
+
+  // Appends `msg` in the layout of the Logger's log file, newline included.
+  // False when its captured arguments are malformed.
+  inline bool Render(const BinaryLogMessage &msg, string &line) {
+    const Site &site = *msg.site;
+    const LogClock::time_point time(
+        std::chrono::duration_cast<LogClock::duration>(
+            std::chrono::nanoseconds(msg.nanos)));
+    const auto precision = static_cast<TimestampPrecision>(
+        msg.flags >> LOG_BINARY_PRECISION_SHIFT);
+
+    std::format_to(std::back_inserter(line), "[{}] - [{}]",
+                   _timestamps.Format(time, precision), ToString(site.level));
+    if (!site.category.empty())
+      std::format_to(std::back_inserter(line), " [{}]", site.category);
+    std::format_to(std::back_inserter(line), " {}:{} in function '{}': ",
+                   site.file, site.line, site.function);
+    if (msg.flags & LOG_BINARY_RAW_ARGS) {
+      _args.clear();
+      if (!readArgs(msg.payload, site, _args))
+        return false;
+      renderMessage(site.fmt, _args, line);
+    } else {
+      line += msg.payload;
+    }
+    if (msg.suppressed > 0)
+      std::format_to(std::back_inserter(line), " (suppressed {} times)",
+                     msg.suppressed);
+    line += '\n';
+    return true;
+  }
+
+private:
+  inline bool fail(const char *what) {
+    _error = what;
+    return false;
+  }
+
+  Reader _in;
+  uint16 _version = LOG_BINARY_VERSION;
+  std::vector<Site> _sites;
+  std::vector<Value> _args;
+  TimestampFormatter _timestamps;
+  const char *_error = nullptr;
+};
+
+} // namespace bb::core::tools
+
+#endif // _GENERIC_BINARY_LOG_READER_HPP
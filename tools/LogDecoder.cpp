@@ -0,0 +1,65 @@
+// Turns a file written by BinaryFileSink back into the text layout the
+// Logger writes to its log file.
+//
+//   LogDecoder <binary log> [output]
+
+#include "BinaryLogReader.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace bb::core;
+
+namespace {
+
+inline bool readFile(const char *path, std::vector<char> &data) {
+  std::FILE *file = std::fopen(path, "rb");
+  if (!file)
+    return false;
+
+  char chunk[64 * 1024];
+  size_t read;
+  while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+    data.insert(data.end(), chunk, chunk + read);
+  std::fclose(file);
+  return true;
+}
+
+inline int fail(const char *what) {
+  std::fprintf(stderr, "LogDecoder: %s\n", what);
+  return 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    std::fprintf(stderr, "usage: %s <binary log> [output]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<char> data;
+  if (!readFile(argv[1], data))
+    return fail("cannot read the input file");
+
+  std::FILE *out = argc == 3 ? std::fopen(argv[2], "w") : stdout;
+  if (!out)
+    return fail("cannot open the output file");
+
+  tools::BinaryLogReader reader({data.data(), data.size()});
+  tools::BinaryLogMessage msg;
+  string line;
+  while (reader.Next(msg)) {
+    line.clear();
+    if (!reader.Render(msg, line))
+      return fail("malformed message arguments");
+    std::fwrite(line.data(), 1, line.size(), out);
+  }
+  if (reader.Error())
+    return fail(reader.Error());
+
+  if (out != stdout)
+    std::fclose(out);
+  return 0;
+}
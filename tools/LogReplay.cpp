@@ -0,0 +1,502 @@
+// Prints the records of a log file that fall in a time range and match a
+// level, category, source file or text, in the layout the Logger writes.
+// The log is mapped and, when it has a side index (see LogIndexEntry), only
+// the blocks the index says may match are read; whatever the index does not
+// cover yet, the tail of a running log say, is scanned in full. Text and
+// binary logs are both understood.
+//
+//   LogReplay <log> [--from TIME] [--to TIME] [--level LEVEL]
+//             [--category NAME] [--file NAME] [--grep TEXT]
+//
+// TIME is local time as the log shows it, "YYYY-MM-DD HH:MM:SS[.fff]", and
+// both ends are inclusive: --to "... 12:00:05" keeps all of that second.
+// LEVEL keeps that level and above; NAME matches a category or a source file
+// basename, ignoring case.
+
+#include "BinaryLogReader.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace bb::core;
+
+namespace {
+
+inline int fail(const char *what) {
+  std::fprintf(stderr, "LogReplay: %s\n", what);
+  return 1;
+}
+
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    const auto lower = [](char c) {
+      return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    };
+    if (lower(a[i]) != lower(b[i]))
+      return false;
+  }
+  return true;
+}
+
+inline bool parseDigits(std::string_view text, size_t pos, size_t count,
+                        int &out) {
+  if (pos + count > text.size())
+    return false;
+  out = 0;
+  for (size_t i = pos; i < pos + count; ++i) {
+    if (text[i] < '0' || text[i] > '9')
+      return false;
+    out = out * 10 + (text[i] - '0');
+  }
+  return true;
+}
+
+// Local "YYYY-MM-DD HH:MM:SS[.fraction]" to nanoseconds since the epoch, the
+// inverse of TimestampFormatter. mktime() is slow, so its result is cached
+// per minute; log lines arrive in order. With `last`, the digits left out
+// count as nines, giving the last nanosecond the text stands for.
+class TimestampParser {
+public:
+  inline std::optional<int64> Parse(std::string_view text,
+                                    bool last = false) {
+    constexpr size_t PREFIX_LENGTH = 19;
+    int second;
+    if (text.size() < PREFIX_LENGTH || text[4] != '-' || text[7] != '-' ||
+        text[10] != ' ' || text[13] != ':' || text[16] != ':' ||
+        !parseDigits(text, 17, 2, second))
+      return std::nullopt;
+
+    const std::string_view minute = text.substr(0, 16);
+    if (minute != std::string_view(_minute, _minuteLength)) {
+      std::tm local{};
+      if (!parseDigits(text, 0, 4, local.tm_year) ||
+          !parseDigits(text, 5, 2, local.tm_mon) ||
+          !parseDigits(text, 8, 2, local.tm_mday) ||
+          !parseDigits(text, 11, 2, local.tm_hour) ||
+          !parseDigits(text, 14, 2, local.tm_min))
+        return std::nullopt;
+      local.tm_year -= 1900;
+      local.tm_mon -= 1;
+      local.tm_isdst = -1;
+      const std::time_t time = std::mktime(&local);
+      if (time == std::time_t(-1))
+        return std::nullopt;
+      _minuteNanos = static_cast<int64>(time) * 1'000'000'000;
+      std::memcpy(_minute, minute.data(), minute.size());
+      _minuteLength = minute.size();
+    }
+
+    int64 fraction = 0;
+    size_t digits = 0;
+    if (text.size() > PREFIX_LENGTH && text[PREFIX_LENGTH] == '.') {
+      for (size_t i = PREFIX_LENGTH + 1;
+           i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+        if (digits < 9) {
+          fraction = fraction * 10 + (text[i] - '0');
+          ++digits;
+        }
+      }
+    }
+    for (; digits < 9; ++digits)
+      fraction = fraction * 10 + (last ? 9 : 0);
+    return _minuteNanos + second * int64{1'000'000'000} + fraction;
+  }
+
+private:
+  char _minute[16] = {};
+  size_t _minuteLength = 0;
+  int64 _minuteNanos = 0;
+};
+
+// What a record must look like to be printed.
+struct Filter {
+  int64 from = std::numeric_limits<int64>::min();
+  int64 to = std::numeric_limits<int64>::max();
+  LogLevel level = LogLevel::Trace;
+  std::string_view category;
+  std::string_view file;
+  std::string_view grep;
+
+  // Whether a block of the index may hold a matching record.
+  inline bool MayMatch(const LogIndexEntry &entry) const noexcept {
+    const uint8 levels =
+        static_cast<uint8>(0xffu << static_cast<int>(level));
+    return entry.maxNanos >= from && entry.minNanos <= to &&
+           (entry.levelMask & levels) != 0 &&
+           (category.empty() ||
+            (entry.categoryMask & detail::logIndexBit(category)) != 0) &&
+           (file.empty() || (entry.fileMask & detail::logIndexBit(file)) != 0);
+  }
+
+  // The text is left to the caller, which searches the whole record.
+  inline bool Matches(int64 nanos, LogLevel recordLevel,
+                      std::string_view recordCategory,
+                      std::string_view recordFile) const noexcept {
+    return nanos >= from && nanos <= to && recordLevel >= level &&
+           (category.empty() || equalsIgnoreCase(category, recordCategory)) &&
+           (file.empty() ||
+            equalsIgnoreCase(file, detail::baseName(recordFile)));
+  }
+};
+
+// The log file, mapped read-only.
+class MappedLog {
+public:
+  inline explicit MappedLog(const char *path) {
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      return;
+
+    struct stat info;
+    if (::fstat(fd, &info) == 0) {
+      _size = static_cast<size_t>(info.st_size);
+      _ok = true;
+      if (_size > 0) {
+        void *data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+          _ok = false;
+        } else {
+          _data = static_cast<const char *>(data);
+          // Only some blocks are read, and each of them front to back.
+          ::madvise(data, _size, MADV_RANDOM);
+        }
+      }
+    }
+    ::close(fd);
+  }
+
+  inline ~MappedLog() {
+    if (_data)
+      ::munmap(const_cast<char *>(_data), _size);
+  }
+
+  MappedLog(const MappedLog &) = delete;
+  MappedLog &operator=(const MappedLog &) = delete;
+
+  inline bool IsOpen() const noexcept { return _ok; }
+  inline std::string_view View() const noexcept { return {_data, _size}; }
+
+private:
+  const char *_data = nullptr;
+  size_t _size = 0;
+  bool _ok = false;
+};
+
+struct ByteRange {
+  uint64 begin;
+  uint64 end;
+};
+
+// The parts of the log to scan: the index blocks that may match, merged, and
+// everything the index does not describe. A missing or unreadable index
+// leaves the whole log.
+inline std::vector<ByteRange> selectRanges(const char *logPath,
+                                           uint64 logSize, bool binary,
+                                           const Filter &filter) {
+  std::vector<char> index;
+  if (std::FILE *file =
+          std::fopen(detail::logIndexPath(logPath).string().c_str(), "rb")) {
+    char chunk[64 * 1024];
+    size_t read;
+    while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+      index.insert(index.end(), chunk, chunk + read);
+    std::fclose(file);
+  }
+
+  LogIndexHeader header{};
+  if (index.size() < sizeof(header))
+    return {{0, logSize}};
+  std::memcpy(&header, index.data(), sizeof(header));
+  if (std::string_view(header.magic, sizeof(header.magic)) !=
+          LOG_INDEX_MAGIC ||
+      header.version != LOG_INDEX_VERSION || (header.binary != 0) != binary) {
+    std::fprintf(stderr, "LogReplay: ignoring an index that does not match "
+                         "the log\n");
+    return {{0, logSize}};
+  }
+
+  std::vector<ByteRange> ranges;
+  uint64 covered = 0;
+  for (size_t pos = sizeof(header); pos + sizeof(LogIndexEntry) <= index.size();
+       pos += sizeof(LogIndexEntry)) {
+    LogIndexEntry entry;
+    std::memcpy(&entry, index.data() + pos, sizeof(entry));
+    if (entry.offset < covered || entry.offset + entry.bytes > logSize)
+      break; // The log was truncated or rewritten since.
+
+    if (entry.offset > covered)
+      ranges.push_back({covered, entry.offset});
+    if (filter.MayMatch(entry))
+      ranges.push_back({entry.offset, entry.offset + entry.bytes});
+    covered = entry.offset + entry.bytes;
+  }
+  if (covered < logSize)
+    ranges.push_back({covered, logSize});
+
+  // Adjacent blocks are scanned in one go; a binary block starts a session
+  // of its own, so neither kind of log cares where a range begins.
+  std::vector<ByteRange> merged;
+  for (const ByteRange &range : ranges) {
+    if (!merged.empty() && merged.back().end == range.begin)
+      merged.back().end = range.end;
+    else
+      merged.push_back(range);
+  }
+  return merged;
+}
+
+// Gathers the output into large writes.
+class Output {
+public:
+  inline ~Output() { Flush(); }
+
+  inline void Append(std::string_view text) {
+    _buffer.append(text);
+    if (_buffer.size() >= 64 * 1024)
+      Flush();
+  }
+
+  inline void Flush() {
+    std::fwrite(_buffer.data(), 1, _buffer.size(), stdout);
+    _buffer.clear();
+  }
+
+private:
+  string _buffer;
+};
+
+// The parts of a text record's first line, which reads
+// "[time] - [LEVEL] [Category] file:line in function '...': message".
+struct TextHeader {
+  int64 nanos;
+  LogLevel level;
+  std::string_view category;
+  std::string_view file;
+};
+
+class TextScanner {
+public:
+  inline TextScanner(std::string_view log, const Filter &filter,
+                     Output &out)
+      : _log(log), _filter(filter), _out(out) {}
+
+  inline void Scan(ByteRange range) {
+    if (_filter.grep.empty()) {
+      size_t pos = static_cast<size_t>(range.begin);
+      while (pos < range.end)
+        pos = printRecord(pos, static_cast<size_t>(range.end));
+      return;
+    }
+
+    // Let memmem() skip through the range and only look at the records
+    // holding a hit.
+    const char *base = _log.data();
+    size_t pos = static_cast<size_t>(range.begin);
+    while (pos < range.end) {
+      const void *hit = ::memmem(base + pos, range.end - pos,
+                                 _filter.grep.data(), _filter.grep.size());
+      if (!hit)
+        break;
+      const size_t start =
+          recordStart(static_cast<size_t>(static_cast<const char *>(hit) -
+                                          base),
+                      static_cast<size_t>(range.begin));
+      pos = printRecord(start, static_cast<size_t>(range.end));
+    }
+  }
+
+private:
+  inline size_t lineEnd(size_t pos, size_t end) const {
+    const void *newline = std::memchr(_log.data() + pos, '\n', end - pos);
+    return newline ? static_cast<size_t>(static_cast<const char *>(newline) -
+                                         _log.data()) +
+                         1
+                   : end;
+  }
+
+  // Walks back from `pos` to the first line of its record.
+  inline size_t recordStart(size_t pos, size_t begin) {
+    for (;;) {
+      while (pos > begin && _log[pos - 1] != '\n')
+        --pos;
+      if (pos == begin || parseHeader(line(pos, _log.size())))
+        return pos;
+      --pos;
+    }
+  }
+
+  inline std::string_view line(size_t pos, size_t end) const {
+    return _log.substr(pos, lineEnd(pos, end) - pos);
+  }
+
+  // Prints the record at `pos` if it matches; returns where the next one
+  // starts. Lines that do not start a record continue the one before.
+  inline size_t printRecord(size_t pos, size_t end) {
+    const std::optional<TextHeader> header = parseHeader(line(pos, end));
+    size_t next = lineEnd(pos, end);
+    while (next < end && !parseHeader(line(next, end)))
+      next = lineEnd(next, end);
+
+    const std::string_view record = _log.substr(pos, next - pos);
+    if (header &&
+        _filter.Matches(header->nanos, header->level, header->category,
+                        header->file) &&
+        (_filter.grep.empty() ||
+         record.find(_filter.grep) != std::string_view::npos))
+      _out.Append(record);
+    return next;
+  }
+
+  inline std::optional<TextHeader> parseHeader(std::string_view line) {
+    if (line.size() < 2 || line[0] != '[')
+      return std::nullopt;
+    const size_t close = line.find("] - [");
+    if (close == std::string_view::npos)
+      return std::nullopt;
+    const std::optional<int64> nanos =
+        _timestamps.Parse(line.substr(1, close - 1));
+    if (!nanos)
+      return std::nullopt;
+
+    std::string_view rest = line.substr(close + 5);
+    size_t end = rest.find(']');
+    if (end == std::string_view::npos)
+      return std::nullopt;
+    const std::optional<LogLevel> level = ParseLogLevel(rest.substr(0, end));
+    if (!level)
+      return std::nullopt;
+    rest.remove_prefix(end + 1);
+
+    TextHeader header{*nanos, *level, {}, {}};
+    if (rest.starts_with(" [")) {
+      end = rest.find(']');
+      if (end == std::string_view::npos)
+        return std::nullopt;
+      header.category = rest.substr(2, end - 2);
+      rest.remove_prefix(end + 1);
+    }
+
+    // " file:line in function '...'"; the path itself may hold colons.
+    end = rest.find(" in function ");
+    if (end == std::string_view::npos || rest.empty())
+      return std::nullopt;
+    const std::string_view location = rest.substr(1, end - 1);
+    header.file = location.substr(0, location.rfind(':'));
+    return header;
+  }
+
+  std::string_view _log;
+  const Filter &_filter;
+  Output &_out;
+  TimestampParser _timestamps;
+};
+
+inline bool scanBinary(std::string_view log, ByteRange range,
+                       const Filter &filter, Output &out) {
+  tools::BinaryLogReader reader(log.substr(
+      static_cast<size_t>(range.begin),
+      static_cast<size_t>(range.end - range.begin)));
+  tools::BinaryLogMessage msg;
+  string line;
+  while (reader.Next(msg)) {
+    const tools::Site &site = *msg.site;
+    if (!filter.Matches(msg.nanos, site.level, site.category, site.file))
+      continue;
+
+    line.clear();
+    if (!reader.Render(msg, line)) {
+      fail("malformed message arguments");
+      return false;
+    }
+    if (filter.grep.empty() ||
+        line.find(filter.grep) != std::string_view::npos)
+      out.Append(line);
+  }
+  if (reader.Error()) {
+    fail(reader.Error());
+    return false;
+  }
+  return true;
+}
+
+inline int usage(const char *self) {
+  std::fprintf(stderr,
+               "usage: %s <log> [--from TIME] [--to TIME] [--level LEVEL]\n"
+               "          [--category NAME] [--file NAME] [--grep TEXT]\n"
+               "TIME is local, \"YYYY-MM-DD HH:MM:SS[.fff]\"\n",
+               self);
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage(argv[0]);
+
+  Filter filter;
+  TimestampParser timestamps;
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view option = argv[i];
+    if (i + 1 == argc)
+      return usage(argv[0]);
+    const std::string_view value = argv[++i];
+
+    if (option == "--from" || option == "--to") {
+      const std::optional<int64> nanos =
+          timestamps.Parse(value, option == "--to");
+      if (!nanos)
+        return fail("times read \"YYYY-MM-DD HH:MM:SS[.fff]\"");
+      (option == "--from" ? filter.from : filter.to) = *nanos;
+    } else if (option == "--level") {
+      const std::optional<LogLevel> level = ParseLogLevel(value);
+      if (!level)
+        return fail("unknown level");
+      filter.level = *level;
+    } else if (option == "--category") {
+      filter.category = value;
+    } else if (option == "--file") {
+      filter.file = value;
+    } else if (option == "--grep") {
+      filter.grep = value;
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  const MappedLog mapped(argv[1]);
+  if (!mapped.IsOpen())
+    return fail("cannot read the log file");
+  const std::string_view log = mapped.View();
+
+  // A binary log starts with a session record.
+  const bool binary =
+      log.size() > LOG_BINARY_MAGIC.size() &&
+      log[0] == static_cast<char>(BinaryLogRecord::Session) &&
+      log.substr(1, LOG_BINARY_MAGIC.size()) == LOG_BINARY_MAGIC;
+
+  Output out;
+  TextScanner text(log, filter, out);
+  for (const ByteRange &range :
+       selectRanges(argv[1], log.size(), binary, filter)) {
+    if (!binary)
+      text.Scan(range);
+    else if (!scanBinary(log, range, filter, out))
+      return 1;
+  }
+  return 0;
+}